@@ -0,0 +1,186 @@
+#!/usr/bin/python
+# -*- coding: utf-8 -*-
+
+# Runs the solver over every data/tsp_* instance with fixed seeds and time budget, and records
+# the best tour length reached by fixed points of time (anytime curve). Results are written to
+# <out>.csv and <out>.json; the json of another build can be given to --compare to find regressions.
+# A point regresses when the median over the seeds got worse by more than the tolerance and the spread
+# of the seeds, and every seed got worse; a failed run, a missing trace or a lost value regresses too.
+#
+#   python bench.py --exe Release/tsp.exe --time 10 --seeds 1,2,3 --modes anneal,eax --out bench
+#   python bench.py --compare bench_old.json --out bench_new
+
+from __future__ import print_function
+
+import argparse
+import csv
+import glob
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def time_points(budget):
+    points = []
+    scale = 0.1
+    while scale < budget:
+        for m in (1, 2, 5):
+            if m * scale < budget:
+                points.append(round(m * scale, 3))
+        scale *= 10
+    points.append(budget)
+    return points
+
+
+def read_trace(file_name):
+    records = []
+    with open(file_name) as f:
+        for line in f:
+            parts = line.split()
+            if len(parts) == 2:
+                records.append((float(parts[0]), float(parts[1])))
+    return records
+
+
+def value_at(records, t):
+    value = None
+    for (rt, rv) in records:
+        if rt > t:
+            break
+        value = rv
+    return value
+
+
+def run(exe, instance, mode, seed, budget, threads):
+    # separate directory so that start/ solutions are not used and logs do not mix
+    work_dir = tempfile.mkdtemp(prefix='tsp_bench_')
+    try:
+        trace = os.path.join(work_dir, 'trace.txt')
+        cmd = [exe, instance, '--mode', mode, '--seed', str(seed),
+               '--time-limit', str(budget), '--trace', trace]
+        if threads:
+            cmd += ['--threads', str(threads)]
+        start = time.time()
+        with open(os.devnull, 'w') as devnull:
+            code = subprocess.call(cmd, cwd=work_dir, stdout=devnull)
+        seconds = time.time() - start
+        return read_trace(trace) if os.path.exists(trace) else None, seconds, code
+    finally:
+        shutil.rmtree(work_dir, ignore_errors=True)
+
+
+def instance_size(file_name):
+    with open(file_name) as f:
+        return int(f.readline().split()[0])
+
+
+def median(values):
+    values = sorted(values)
+    m = len(values) // 2
+    return values[m] if len(values) % 2 else (values[m - 1] + values[m]) / 2.0
+
+
+def spread(values):
+    # relative range of the seeds, the noise a change has to exceed
+    return (max(values) - min(values)) / median(values) if len(values) > 1 else 0.0
+
+
+def compare(old, new, tolerance):
+    old_runs = dict(((r['instance'], r['mode'], r['seed']), r) for r in old['runs'])
+    groups = {}
+    regressions = 0
+    for r in new['runs']:
+        name = '%s %s seed=%d' % (r['instance'], r['mode'], r['seed'])
+        # runs of older json have no exit code and a missing trace as an empty curve
+        if r.get('exit', 0) != 0:
+            print('%s: exit code %d  REGRESSION' % (name, r['exit']))
+            regressions += 1
+        if not r.get('trace', True) or all(v is None for v in r['curve']):
+            print('%s: no trace  REGRESSION' % name)
+            regressions += 1
+            continue
+        o = old_runs.get((r['instance'], r['mode'], r['seed']))
+        if o is None or o['points'] != r['points']:
+            continue
+        for (t, nv, ov) in zip(r['points'], r['curve'], o['curve']):
+            if ov is None:
+                continue
+            if nv is None:
+                print('%s: no value at %gs  REGRESSION' % (name, t))
+                regressions += 1
+                continue
+            groups.setdefault((r['instance'], r['mode'], t), []).append((ov, nv))
+
+    print('%-14s %-8s %8s %10s %8s' % ('instance', 'mode', 'time', 'change', 'noise'))
+    for key in sorted(groups):
+        old_values = [ov for (ov, nv) in groups[key]]
+        new_values = [nv for (ov, nv) in groups[key]]
+        change = median(new_values) / median(old_values) - 1
+        noise = max(tolerance, spread(old_values), spread(new_values))
+        flag = ''
+        if change > noise and all(nv > ov for (ov, nv) in groups[key]):
+            flag = '  REGRESSION'
+            regressions += 1
+        print('%-14s %-8s %8g %+9.3f%% %7.3f%%%s' % (key[0], key[1], key[2], 100 * change, 100 * noise, flag))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description='TSP solver benchmark')
+    parser.add_argument('--exe', default='Release/tsp.exe')
+    parser.add_argument('--data', default='data')
+    parser.add_argument('--time', type=float, default=10, help='seconds per run')
+    parser.add_argument('--seeds', default='1,2,3')
+    parser.add_argument('--modes', default='anneal,eax')
+    parser.add_argument('--threads', type=int, default=0, help='0 - solver default')
+    parser.add_argument('--only', default='', help='run only instances with this substring')
+    parser.add_argument('--label', default='', help='name of the build stored in json')
+    parser.add_argument('--out', default='bench')
+    parser.add_argument('--compare', default='', help='json of previous build')
+    parser.add_argument('--tolerance', type=float, default=0.005,
+                        help='least relative increase of the median tour length reported as regression, '
+                             'raised to the spread of the seeds')
+    args = parser.parse_args()
+
+    exe = os.path.abspath(args.exe)
+    instances = sorted(glob.glob(os.path.join(args.data, 'tsp_*')), key=instance_size)
+    instances = [i for i in instances if args.only in os.path.basename(i)]
+    points = time_points(args.time)
+
+    result = {'label': args.label, 'time': args.time, 'runs': []}
+    with open(args.out + '.csv', 'w') as f:
+        out = csv.writer(f, lineterminator='\n')
+        out.writerow(['instance', 'n', 'mode', 'seed', 'time', 'value'])
+        for instance in instances:
+            name = os.path.basename(instance)
+            for mode in args.modes.split(','):
+                for seed in [int(s) for s in args.seeds.split(',')]:
+                    records, seconds, code = run(exe, os.path.abspath(instance), mode, seed, args.time,
+                                                 args.threads)
+                    curve = [value_at(records or [], t) for t in points]
+                    for (t, v) in zip(points, curve):
+                        out.writerow([name, instance_size(instance), mode, seed, t, v if v is not None else ''])
+                    result['runs'].append({'instance': name, 'n': instance_size(instance), 'mode': mode,
+                                           'seed': seed, 'points': points, 'curve': curve,
+                                           'seconds': seconds, 'exit': code, 'trace': records is not None})
+                    print('%s\t%s\tseed=%d\t%.1fs\texit=%d\tfinal=%s' % (name, mode, seed, seconds, code,
+                                                                      curve[-1]))
+                    sys.stdout.flush()
+
+    with open(args.out + '.json', 'w') as f:
+        json.dump(result, f, indent=1)
+
+    if args.compare:
+        with open(args.compare) as f:
+            old = json.load(f)
+        if compare(old, result, args.tolerance) > 0:
+            return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
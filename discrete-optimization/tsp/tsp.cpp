@@ -1,16 +1,52 @@
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cfloat>
+#include <csignal>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <queue>
 #include <set>
+#include <string>
+#include <thread>
 #include <vector>
 #include <fstream>
+#include <functional>
 #include <sstream>
 #include <random>
 
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 int N = 0;
 
-std::default_random_engine re;
+// each thread has its own engine, worker threads seed it for every task
+thread_local std::default_random_engine re;
+
+// long optimizations are cut short after the deadline (--time-limit)
+std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+inline bool pastDeadline()
+{
+  return std::chrono::steady_clock::now() >= deadline;
+}
 
 struct Point
 {
@@ -31,20 +67,358 @@ inline double dist(const Point & a, const Point & b)
 
 std::vector<Point> points;
 
+// number of candidate neighbours per point
+int K = 0;
+// neighbors[i*K + k] is the k-th nearest point to point i
+std::vector<int> neighbors;
+
+// fills res[i*k ..] with k nearest points to each of given points using uniform grid with about 2 points per cell,
+// returns k that can be reduced if there are few points
+int findNeighbors(const std::vector<Point> & pts, int k, std::vector<int> & res)
+{
+  int n = (int)pts.size();
+  int nk = std::min(k, n - 1);
+  res.assign((size_t)n * std::max(nk, 0), -1);
+  if (nk <= 0)
+    return 0;
+
+  Point lo = pts[0], hi = pts[0];
+  for (const auto & pt : pts)
+  {
+    lo.x = std::min(lo.x, pt.x);
+    lo.y = std::min(lo.y, pt.y);
+    hi.x = std::max(hi.x, pt.x);
+    hi.y = std::max(hi.y, pt.y);
+  }
+  double cell = sqrt(std::max((hi.x - lo.x) * (hi.y - lo.y), 1e-9) * 2 / n);
+  if (cell <= 0)
+    cell = 1;
+  int gx = std::max(1, std::min(4096, (int)((hi.x - lo.x) / cell) + 1));
+  int gy = std::max(1, std::min(4096, (int)((hi.y - lo.y) / cell) + 1));
+  cell = std::max((hi.x - lo.x) / gx, (hi.y - lo.y) / gy) * (1 + 1e-9);
+  if (cell <= 0)
+    cell = 1;
+
+  auto cellX = [&](const Point & pt) { return std::min(gx - 1, (int)((pt.x - lo.x) / cell)); };
+  auto cellY = [&](const Point & pt) { return std::min(gy - 1, (int)((pt.y - lo.y) / cell)); };
+
+  // counting sort of points by cell
+  std::vector<int> cellStart(gx * gy + 1, 0);
+  for (const auto & pt : pts)
+    ++cellStart[cellY(pt) * gx + cellX(pt) + 1];
+  std::partial_sum(cellStart.begin(), cellStart.end(), cellStart.begin());
+  std::vector<int> cellPoints(n);
+  std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+  for (int i = 0; i < n; ++i)
+    cellPoints[fill[cellY(pts[i]) * gx + cellX(pts[i])]++] = i;
+
+  std::priority_queue<std::pair<double, int>> heap; // farthest of found neighbours on top
+  for (int i = 0; i < n; ++i)
+  {
+    int cx = cellX(pts[i]);
+    int cy = cellY(pts[i]);
+    for (int r = 0; r < std::max(gx, gy); ++r)
+    {
+      for (int y = cy - r; y <= cy + r; ++y)
+      {
+        if (y < 0 || y >= gy)
+          continue;
+        bool edgeRow = y == cy - r || y == cy + r;
+        for (int x = cx - r; x <= cx + r; x += edgeRow ? 1 : 2 * r)
+        {
+          if (x >= 0 && x < gx)
+          {
+            int c = y * gx + x;
+            for (int q = cellStart[c]; q < cellStart[c + 1]; ++q)
+            {
+              int j = cellPoints[q];
+              if (j == i)
+                continue;
+              double d = dist2(pts[i], pts[j]);
+              if ((int)heap.size() < nk)
+                heap.emplace(d, j);
+              else if (d < heap.top().first)
+              {
+                heap.pop();
+                heap.emplace(d, j);
+              }
+            }
+          }
+          if (r == 0)
+            break;
+        }
+      }
+      // all not yet scanned pts are farther than r*cell
+      if ((int)heap.size() == nk && heap.top().first <= r * cell * r * cell)
+        break;
+    }
+    for (int q = (int)heap.size() - 1; q >= 0; --q)
+    {
+      res[(size_t)i * nk + q] = heap.top().second;
+      heap.pop();
+    }
+  }
+  return nk;
+}
+
+// read-only view of whole file mapped into memory
+class MappedFile
+{
+public:
+  explicit MappedFile(const char * filename);
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile & operator =(const MappedFile &) = delete;
+  const char * data() const { return data_; }
+  size_t size() const { return size_; }
+private:
+  const char * data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  HANDLE file_ = INVALID_HANDLE_VALUE;
+  HANDLE mapping_ = nullptr;
+#endif
+};
+
+MappedFile::MappedFile(const char * filename)
+{
+#ifdef _WIN32
+  file_ = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file_ == INVALID_HANDLE_VALUE)
+    return;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0)
+    return;
+  mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping_)
+    return;
+  data_ = (const char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+  if (data_)
+    size_ = (size_t)size.QuadPart;
+#else
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+  {
+    void * p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED)
+    {
+      madvise(p, st.st_size, MADV_SEQUENTIAL);
+      data_ = (const char*)p;
+      size_ = st.st_size;
+    }
+  }
+  close(fd);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+  if (data_)
+    UnmapViewOfFile(data_);
+  if (mapping_)
+    CloseHandle(mapping_);
+  if (file_ != INVALID_HANDLE_VALUE)
+    CloseHandle(file_);
+#else
+  if (data_)
+    munmap((void*)data_, size_);
+#endif
+}
+
+// parses whitespace separated decimal numbers from memory
+class NumberReader
+{
+public:
+  NumberReader(const char * begin, const char * end) : p_(begin), end_(end) {}
+  // returns false if there is no number
+  bool read(double & x);
+  bool read(int & x);
+private:
+  void skipSpaces_()
+  {
+    while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r'))
+      ++p_;
+  }
+  const char * p_;
+  const char * end_;
+};
+
+bool NumberReader::read(double & x)
+{
+  skipSpaces_();
+  const char * start = p_;
+  bool neg = p_ < end_ && *p_ == '-';
+  if (p_ < end_ && (*p_ == '-' || *p_ == '+'))
+    ++p_;
+  uint64_t mantissa = 0;
+  int digits = 0, exp10 = 0;
+  for (; p_ < end_ && *p_ >= '0' && *p_ <= '9'; ++p_, ++digits)
+    mantissa = mantissa * 10 + (*p_ - '0');
+  if (p_ < end_ && *p_ == '.')
+  {
+    for (++p_; p_ < end_ && *p_ >= '0' && *p_ <= '9'; ++p_, ++digits, --exp10)
+      mantissa = mantissa * 10 + (*p_ - '0');
+  }
+  if (p_ < end_ && (*p_ == 'e' || *p_ == 'E'))
+  {
+    const char * e = p_ + 1;
+    bool eneg = e < end_ && *e == '-';
+    if (e < end_ && (*e == '-' || *e == '+'))
+      ++e;
+    int ev = 0;
+    if (e < end_ && *e >= '0' && *e <= '9')
+    {
+      for (; e < end_ && *e >= '0' && *e <= '9'; ++e)
+        ev = std::min(ev * 10 + (*e - '0'), 100000);
+      exp10 += eneg ? -ev : ev;
+      p_ = e;
+    }
+  }
+  if (digits == 0)
+  {
+    p_ = start;
+    return false;
+  }
+
+  // both mantissa and power of 10 are exact doubles, so one multiplication or division is correctly rounded
+  static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+  if (digits <= 15 && exp10 >= -22 && exp10 <= 22)
+  {
+    x = (double)mantissa;
+    x = exp10 < 0 ? x / pow10[-exp10] : x * pow10[exp10];
+    if (neg)
+      x = -x;
+    return true;
+  }
+
+  // rare long numbers are converted by the library
+  std::string text(start, p_);
+  x = strtod(text.c_str(), nullptr);
+  return true;
+}
+
+bool NumberReader::read(int & x)
+{
+  double d;
+  if (!read(d))
+    return false;
+  x = (int)d;
+  return true;
+}
+
+// reads N and points from given file, returns false on error
+bool readPoints(const char * filename)
+{
+  MappedFile file(filename);
+  if (!file.data())
+    return false;
+  NumberReader reader(file.data(), file.data() + file.size());
+  if (!reader.read(N) || N < 0)
+    return false;
+  points.resize(N);
+  for (auto & pt : points)
+  {
+    if (!reader.read(pt.x) || !reader.read(pt.y))
+      return false;
+  }
+  return true;
+}
+
+// accumulates text in memory and writes it to the stream in large blocks
+class BufferedWriter
+{
+public:
+  explicit BufferedWriter(std::ostream & os) : os_(os) { buf_.reserve(CAPACITY); }
+  ~BufferedWriter() { flush(); }
+  void put(char c)
+  {
+    buf_.push_back(c);
+    if (buf_.size() >= CAPACITY)
+      flush();
+  }
+  // writes non-negative integer
+  void put(int x)
+  {
+    char digits[16];
+    int n = 0;
+    do
+    {
+      digits[n++] = (char)('0' + x % 10);
+      x /= 10;
+    } while (x > 0);
+    while (n > 0)
+      buf_.push_back(digits[--n]);
+    if (buf_.size() >= CAPACITY)
+      flush();
+  }
+  void flush()
+  {
+    os_.write(buf_.data(), buf_.size());
+    buf_.clear();
+  }
+private:
+  static const size_t CAPACITY = 1 << 16;
+  std::ostream & os_;
+  std::string buf_;
+};
+
 class Path
 {
 public:
   // creates random path
   Path();
+  // creates path over given points in their order; if fixedEnds, the edge between the last and
+  // the first points is never removed, so the points remain the ends of the open path
+  Path(const std::vector<Point> & pts, bool fixedEnds);
   double value() const;
   void print(std::ostream & os) const;
   void read(std::istream & is);
   int twoOpt(int i, int j, double T, double prob);
   void allShortTwoOpts(int maxDist);
   void manyTwoOps(int tries, double T);
-  void fullOptimize(double T);
+  // annealing in 7 levels of decreasing temperature, the number of tries doubles each level
+  void fullOptimize(double T, int tries = 25000);
+  // sets k nearest neighbours of each point (see findNeighbors) used by the neighbour moves
+  void setNeighbors(const std::vector<int> & nbrs, int k);
+  // makes the path 2-optimal with respect to the moves adding an edge to one of nearest neighbours
+  void neighborTwoOpts();
+  // moves segments of 1-3 cities next to a nearest neighbour of their end while it shortens the path
+  void neighborOrOpts();
+  const std::vector<int> & order() const { return order_; }
+  void setOrder(const std::vector<int> & order);
+  // position of given city in the order
+  int pos(int c) const { return pos_[c]; }
+  int next(int c) const { return order_[pos_[c] + 1 < n_ ? pos_[c] + 1 : 0]; }
+  int prev(int c) const { return order_[pos_[c] > 0 ? pos_[c] - 1 : n_ - 1]; }
+  // whether b is met on the way from a forward to c (inclusive)
+  bool between(int a, int b, int c) const
+  {
+    int pa = pos_[a], pb = pos_[b], pc = pos_[c];
+    return pa <= pc ? pa <= pb && pb <= pc : pb >= pa || pb <= pc;
+  }
 private:
+  const Point & pt_(int i) const { return (*pts_)[order_[i]]; }
+  double d_(int a, int b) const { return dist((*pts_)[a], (*pts_)[b]); }
+  // updates pos_ of the cities at cyclic positions [from, to]
+  void updatePos_(int from, int to);
+  // reverses exactly cyclic positions [from, to]
+  void reverse_(int from, int to);
+  // moves the cities at cyclic positions [i, j] between positions p and p+1, optionally reversed
+  void moveSegment_(int i, int j, int p, bool reversed);
+  bool fixed_(int a, int b) const { return (a == fixedA_ && b == fixedB_) || (a == fixedB_ && b == fixedA_); }
+
+  const std::vector<Point> * pts_ = &points;
+  int n_ = N;
+  const std::vector<int> * nbrs_ = &neighbors;
+  int k_ = K;
+  int fixedA_ = -1, fixedB_ = -1; // the ends of the edge that is never removed
   std::vector<int> order_;
+  std::vector<int> pos_; // pos_[order_[i]] == i
 };
 
 Path::Path()
@@ -55,19 +429,102 @@ Path::Path()
     order_[i] = i;
   }
   std::random_shuffle(order_.begin(), order_.end());
+  pos_.resize(N);
+  updatePos_(0, N - 1);
+}
+
+Path::Path(const std::vector<Point> & pts, bool fixedEnds)
+  : pts_(&pts)
+  , n_((int)pts.size())
+  , nbrs_(nullptr)
+  , k_(0)
+{
+  order_.resize(n_);
+  for (int i = 0; i < n_; ++i)
+  {
+    order_[i] = i;
+  }
+  pos_ = order_;
+  if (fixedEnds)
+  {
+    fixedA_ = 0;
+    fixedB_ = n_ - 1;
+  }
+}
+
+void Path::setOrder(const std::vector<int> & order)
+{
+  order_ = order;
+  pos_.resize(n_);
+  updatePos_(0, n_ - 1);
+}
+
+void Path::setNeighbors(const std::vector<int> & nbrs, int k)
+{
+  nbrs_ = &nbrs;
+  k_ = k;
+}
+
+void Path::updatePos_(int from, int to)
+{
+  for (int i = from; ; i = i + 1 < n_ ? i + 1 : 0)
+  {
+    pos_[order_[i]] = i;
+    if (i == to)
+      break;
+  }
+}
+
+void Path::reverse_(int from, int to)
+{
+  int len = to - from;
+  if (len < 0)
+    len += n_;
+  ++len;
+  for (int k = 0; k < len / 2; ++k)
+  {
+    std::swap(order_[from], order_[to]);
+    pos_[order_[from]] = from;
+    pos_[order_[to]] = to;
+    from = from + 1 < n_ ? from + 1 : 0;
+    to = to > 0 ? to - 1 : n_ - 1;
+  }
+}
+
+void Path::moveSegment_(int i, int j, int p, bool reversed)
+{
+  int len = (j - i + n_) % n_ + 1;
+  int fwd = (p - j + n_) % n_; // cities passed if the segment moves forward
+  if (2 * fwd + len <= n_)
+  {
+    // S B -> B S
+    reverse_(i, p);
+    reverse_(i, (i + fwd - 1) % n_);
+    if (!reversed)
+      reverse_((i + fwd) % n_, p);
+  }
+  else
+  {
+    // B S -> S B, where B starts after p
+    int q = (p + 1) % n_;
+    reverse_(q, j);
+    if (!reversed)
+      reverse_(q, (q + len - 1) % n_);
+    reverse_((q + len) % n_, j);
+  }
 }
 
 // attempts to reverse the order of traversal in [i+1, j] or in [j+1,i] (whatever is smaller)
 // returns the number of changed elements or 0 if the reverse is rejected
 int Path::twoOpt(int i, int j, double T, double prob)
 {
-  int i1 = i + 1 < N ? i + 1 : 0;
-  int j1 = j + 1 < N ? j + 1 : 0;
+  int i1 = i + 1 < n_ ? i + 1 : 0;
+  int j1 = j + 1 < n_ ? j + 1 : 0;
   int n = j - i;
   if (n < 0)
-    n += N;
-  assert(n >= 0 && n <= N);
-  int nb = N - n;
+    n += n_;
+  assert(n >= 0 && n <= n_);
+  int nb = n_ - n;
   if (nb < n)
   {
     std::swap(i, j);
@@ -77,10 +534,13 @@ int Path::twoOpt(int i, int j, double T, double prob)
   if (n <= 1)
     return 0;
 
-  double iOld = dist(points[order_[i]], points[order_[i1]]);
-  double jOld = dist(points[order_[j]], points[order_[j1]]);
-  double iNew = dist(points[order_[i]], points[order_[j]]);
-  double jNew = dist(points[order_[i1]], points[order_[j1]]);
+  if (fixed_(order_[i], order_[i1]) || fixed_(order_[j], order_[j1]))
+    return 0;
+
+  double iOld = dist(pt_(i), pt_(i1));
+  double jOld = dist(pt_(j), pt_(j1));
+  double iNew = dist(pt_(i), pt_(j));
+  double jNew = dist(pt_(i1), pt_(j1));
   double delta = iOld + jOld - iNew - jNew;
   if (delta <= 0)
   {
@@ -94,7 +554,7 @@ int Path::twoOpt(int i, int j, double T, double prob)
   {
     std::reverse(order_.begin() + i + 1, order_.begin() + j + 1);
   }
-  else if (i + j + 2 < N)
+  else if (i + j + 2 < n_)
   {
     for (int k = 0; k < j + 1; ++k)
     {
@@ -104,31 +564,34 @@ int Path::twoOpt(int i, int j, double T, double prob)
   }
   else
   {
-    for (int k = 0; i + 1 + k < N; ++k) // k_max = N - i - 2
+    for (int k = 0; i + 1 + k < n_; ++k) // k_max = n_ - i - 2
     {
       std::swap(order_[i + 1 + k], order_[j - k]);
     }
-    std::reverse(order_.begin(), order_.begin() + (j + i + 2 - N));
+    std::reverse(order_.begin(), order_.begin() + (j + i + 2 - n_));
   }
+  updatePos_(i1, j);
 
   return n;
 }
 
 void Path::manyTwoOps(int tries, double T)
 {
-  std::uniform_int_distribution<> dis(0, N - 1);
+  std::uniform_int_distribution<> dis(0, n_ - 1);
   std::uniform_real_distribution<> probDist(0, 1);
   for (int i = 0; i < tries; ++i)
   {
+    if ((i & 4095) == 0 && pastDeadline())
+      break;
     twoOpt(dis(re), dis(re), T, probDist(re));
   }
 }
 
-void Path::fullOptimize(double T)
+void Path::fullOptimize(double T, int tries)
 {
   int LEVELS = 7;
-  int TRIES = 25000;
-  for (int l = 0; l < LEVELS; ++l)
+  int TRIES = tries;
+  for (int l = 0; l < LEVELS && !pastDeadline(); ++l)
   {
     if (l + 1 == LEVELS)
       T = 0;
@@ -141,21 +604,131 @@ void Path::fullOptimize(double T)
 
 void Path::allShortTwoOpts(int maxDist)
 {
-  for (int i = 0; i < N; ++i)
+  for (int i = 0; i < n_; ++i)
   {
     for (int j = 2; j <= maxDist; ++j)
     {
-      twoOpt(i, (i + j) % N, 0, 0);
+      twoOpt(i, (i + j) % n_, 0, 0);
+    }
+  }
+}
+
+void Path::neighborTwoOpts()
+{
+  if (!nbrs_)
+    return;
+  // queue of cities whose edges may be improved ("don't look bits" are off)
+  std::vector<int> queue(order_);
+  std::vector<bool> queued(n_, true);
+  for (size_t q = 0; q < queue.size(); ++q)
+  {
+    if ((q & 1023) == 0 && pastDeadline())
+      break;
+    int a = queue[q];
+    queued[a] = false;
+    for (int dir = 0; dir < 2; ++dir)
+    {
+      int a1 = dir == 0 ? next(a) : prev(a);
+      double da = d_(a, a1);
+      int changed = 0;
+      for (int k = 0; k < k_ && !changed; ++k)
+      {
+        int c = (*nbrs_)[(size_t)a * k_ + k];
+        if (d_(a, c) >= da)
+          break;
+        int c1 = dir == 0 ? next(c) : prev(c);
+        // removes edges (a, a1) and (c, c1), adds (a, c) and (a1, c1);
+        // gains within rounding errors are skipped not to cycle among equal paths
+        double gain = da + d_(c, c1) - d_(a, c) - d_(a1, c1);
+        if (gain <= 1e-9)
+          continue;
+        changed = dir == 0 ? twoOpt(pos_[a], pos_[c], 0, 0) : twoOpt(pos_[a1], pos_[c1], 0, 0);
+        if (changed)
+        {
+          for (int x : { a, a1, c, c1 })
+          {
+            if (!queued[x])
+            {
+              queued[x] = true;
+              queue.push_back(x);
+            }
+          }
+        }
+      }
+      if (changed)
+        break;
+    }
+  }
+}
+
+void Path::neighborOrOpts()
+{
+  if (!nbrs_)
+    return;
+  std::vector<int> queue(order_);
+  std::vector<bool> queued(n_, true);
+  auto push = [&](int x)
+  {
+    if (!queued[x])
+    {
+      queued[x] = true;
+      queue.push_back(x);
+    }
+  };
+  for (size_t q = 0; q < queue.size(); ++q)
+  {
+    if ((q & 1023) == 0 && pastDeadline())
+      break;
+    int s1 = queue[q];
+    queued[s1] = false;
+    bool moved = false;
+    for (int len = 1; len <= 3 && len + 3 <= n_ && !moved; ++len)
+    {
+      int i = pos_[s1];
+      int j = (i + len - 1) % n_;
+      int sL = order_[j];
+      int a = prev(s1), b = next(sL);
+      if (fixed_(a, s1) || fixed_(sL, b))
+        continue;
+      double removeGain = d_(a, s1) + d_(sL, b) - d_(a, b);
+      if (removeGain <= 1e-9)
+        continue;
+      for (int end = 0; end < 2 && !moved; ++end)
+      {
+        int e = end == 0 ? s1 : sL;
+        for (int k = 0; k < k_ && !moved; ++k)
+        {
+          int c = (*nbrs_)[(size_t)e * k_ + k];
+          if (d_(e, c) >= removeGain)
+            break;
+          // insertion between x and y, the next city after x
+          for (int side = 0; side < 2 && !moved; ++side)
+          {
+            int x = side == 0 ? c : prev(c);
+            int y = next(x);
+            if (between(s1, x, sL) || between(s1, y, sL) || fixed_(x, y))
+              continue;
+            double straight = d_(x, s1) + d_(sL, y) - d_(x, y);
+            double reversed = d_(x, sL) + d_(s1, y) - d_(x, y);
+            if (removeGain - std::min(straight, reversed) <= 1e-9)
+              continue;
+            moveSegment_(i, j, pos_[x], reversed < straight);
+            for (int z : { s1, sL, a, b, x, y })
+              push(z);
+            moved = true;
+          }
+        }
+      }
     }
   }
 }
 
 double Path::value() const
 {
-  double res = dist(points[order_.back()], points[order_.front()]);
-  for (int i = 0; i + 1 < N; ++i)
+  double res = dist(pt_(n_ - 1), pt_(0));
+  for (int i = 0; i + 1 < n_; ++i)
   {
-    res += dist(points[order_[i]], points[order_[i+1]]);
+    res += dist(pt_(i), pt_(i+1));
   }
   return res;
 }
@@ -164,9 +737,11 @@ void Path::print(std::ostream & os) const
 {
   os << value() << " 0\n";
 
-  for (int i = 0; i < N; ++i)
+  BufferedWriter w(os);
+  for (int i = 0; i < n_; ++i)
   {
-    os << order_[i] << ' ';
+    w.put(order_[i]);
+    w.put(' ');
   }
 }
 
@@ -176,24 +751,1238 @@ void Path::read(std::istream & is)
   int opt;
   is >> v >> opt;
 
-  for (int i = 0; i < N; ++i)
+  for (int i = 0; i < n_; ++i)
   {
     is >> order_[i];
   }
+  updatePos_(0, n_ - 1);
+}
+
+// replaces file [to] with [from], so that readers see either old or new content of [to]
+bool replaceFile(const std::string & from, const std::string & to)
+{
+#ifdef _WIN32
+  return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+// binary snapshot of the search state sufficient to continue the run from the next iteration:
+//   header, engine state (text of length rngLength), current path order, best path order (int32 each)
+struct CheckpointHeader
+{
+  char magic[4] = { 'T', 'S', 'P', 'C' };
+  int32_t version = 1;
+  int32_t n = 0;
+  int32_t iter = 0; // first iteration to run after resume
+  int32_t bestIter = -1;
+  int32_t rngLength = 0;
+};
+
+struct Checkpoint
+{
+  CheckpointHeader header;
+  std::string rng;
+  std::vector<int32_t> current;
+  std::vector<int32_t> best;
+
+  void write(std::ostream & os) const;
+  // returns false if the file is not a checkpoint of this instance or is damaged
+  bool read(std::istream & is);
+private:
+  static const int32_t MAX_RNG_LENGTH = 16384; // text of the engine state, that of mt19937 takes about 7 KB
+  static bool isTour_(const std::vector<int32_t> & order);
+};
+
+void Checkpoint::write(std::ostream & os) const
+{
+  CheckpointHeader h = header;
+  h.rngLength = (int32_t)rng.size();
+  os.write((const char*)&h, sizeof(h));
+  os.write(rng.data(), rng.size());
+  os.write((const char*)current.data(), current.size() * sizeof(int32_t));
+  os.write((const char*)best.data(), best.size() * sizeof(int32_t));
+}
+
+bool Checkpoint::read(std::istream & is)
+{
+  CheckpointHeader h;
+  if (!is.read((char*)&header, sizeof(header)))
+    return false;
+  if (memcmp(header.magic, h.magic, sizeof(h.magic)) != 0 || header.version != h.version)
+    return false;
+  // a damaged length must not get to the allocation
+  if (header.n != N || header.rngLength < 0 || header.rngLength > MAX_RNG_LENGTH || header.iter < 0)
+    return false;
+  rng.resize(header.rngLength);
+  if (!is.read(&rng[0], rng.size()))
+    return false;
+  current.resize(N);
+  if (!is.read((char*)current.data(), current.size() * sizeof(int32_t)))
+    return false;
+  best.resize(N);
+  if (!is.read((char*)best.data(), best.size() * sizeof(int32_t)))
+    return false;
+  return isTour_(current) && isTour_(best);
+}
+
+bool Checkpoint::isTour_(const std::vector<int32_t> & order)
+{
+  if ((int)order.size() != N)
+    return false;
+  std::vector<char> seen(N, 0);
+  for (int32_t c : order)
+  {
+    if (c < 0 || c >= N || seen[c])
+      return false;
+    seen[c] = 1;
+  }
+  return true;
+}
+
+// writes the latest published checkpoint from a background thread every [period] seconds,
+// so that the optimization loop only pays for copying the state
+class Checkpointer
+{
+public:
+  Checkpointer(const std::string & filename, double period);
+  ~Checkpointer();
+  void publish(int iter, int bestIter, const Path & current, const Path & best);
+private:
+  void run_();
+  void save_(const Checkpoint & c) const;
+
+  std::string filename_;
+  double period_ = 0;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  bool dirty_ = false;
+  Checkpoint latest_;
+  std::thread thread_;
+};
+
+Checkpointer::Checkpointer(const std::string & filename, double period)
+  : filename_(filename)
+  , period_(period)
+{
+  thread_ = std::thread([this]() { run_(); });
+}
+
+Checkpointer::~Checkpointer()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+void Checkpointer::publish(int iter, int bestIter, const Path & current, const Path & best)
+{
+  Checkpoint c;
+  c.header.n = N;
+  c.header.iter = iter;
+  c.header.bestIter = bestIter;
+  std::ostringstream rs;
+  rs << re;
+  c.rng = rs.str();
+  c.current.assign(current.order().begin(), current.order().end());
+  c.best.assign(best.order().begin(), best.order().end());
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::swap(latest_, c);
+  dirty_ = true;
+}
+
+void Checkpointer::run_()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;)
+  {
+    cv_.wait_for(lock, std::chrono::duration<double>(period_), [this]() { return stop_; });
+    if (dirty_)
+    {
+      Checkpoint c = latest_;
+      dirty_ = false;
+      lock.unlock();
+      save_(c);
+      lock.lock();
+    }
+    if (stop_)
+      return;
+  }
+}
+
+void Checkpointer::save_(const Checkpoint & c) const
+{
+  std::string tmp = filename_ + ".tmp";
+  {
+    std::ofstream f(tmp, std::ofstream::binary | std::ofstream::trunc);
+    c.write(f);
+    if (!f)
+      return;
+  }
+  replaceFile(tmp, filename_);
+}
+
+// permits an action at most once per given period of seconds
+class RateLimiter
+{
+public:
+  explicit RateLimiter(double period) : period_(period) {}
+  bool ready()
+  {
+    auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - last_).count() < period_)
+      return false;
+    last_ = now;
+    return true;
+  }
+private:
+  double period_ = 0;
+  std::chrono::steady_clock::time_point last_;
+};
+
+// Held-Karp lower bound of the tour length: the best 1-tree bound found by subgradient optimization
+// of node penalties. The ascent runs on MSTs of the candidate neighbour graph in a background thread;
+// after each ascent the bound is computed on the complete graph before being published, and the edges
+// of complete 1-tree missing among candidates are added for the next ascent.
+class LowerBound
+{
+  struct Edge
+  {
+    int a, b;
+    double len;
+  };
+public:
+  LowerBound();
+  ~LowerBound();
+  // the best confirmed lower bound found so far (0 in the beginning)
+  double value() const { return value_.load(); }
+  // informs the ascent about the length of the best known tour
+  void setUpperBound(double ub) { upperBound_.store(ub); }
+  // instances up to this size get the bound without --gap, the dense 1-tree is O(N^2)
+  static const int CHEAP_N = 5000;
+private:
+  void run_();
+  // returns the weight of minimal 1-tree in candidate graph with given node penalties, fills node degrees
+  double sparseOneTree_(const std::vector<double> & pi, std::vector<int> & degree) const;
+  // returns the exact weight of minimal 1-tree with given node penalties (O(N^2)), fills its edges except of node 0
+  double denseOneTree_(const std::vector<double> & pi, std::vector<Edge> & tree) const;
+  // adds to edges_ the candidate edges and the shortest links between disconnected components
+  void buildEdges_();
+
+  std::vector<Edge> edges_; // without edges of node 0
+  std::set<std::pair<int, int>> edgeSet_; // (smaller, larger) node of each edge in edges_
+  std::atomic<double> value_{ 0 };
+  std::atomic<double> upperBound_{ 0 };
+  std::atomic<bool> stop_{ false };
+  std::thread thread_;
+};
+
+// disjoint-set forest with path halving
+struct UnionFind
+{
+  std::vector<int> parent;
+  explicit UnionFind(int n) : parent(n) { std::iota(parent.begin(), parent.end(), 0); }
+  int find(int a)
+  {
+    while (parent[a] != a)
+      a = parent[a] = parent[parent[a]];
+    return a;
+  }
+  bool unite(int a, int b)
+  {
+    a = find(a);
+    b = find(b);
+    if (a == b)
+      return false;
+    parent[a] = b;
+    return true;
+  }
+};
+
+LowerBound::LowerBound()
+{
+  if (N >= 3)
+    thread_ = std::thread([this]() { run_(); });
+}
+
+LowerBound::~LowerBound()
+{
+  stop_ = true;
+  if (thread_.joinable())
+    thread_.join();
+}
+
+void LowerBound::buildEdges_()
+{
+  auto addEdge = [&](int i, int j)
+  {
+    if (edgeSet_.insert(std::make_pair(std::min(i, j), std::max(i, j))).second)
+      edges_.push_back({ i, j, dist(points[i], points[j]) });
+  };
+  for (int i = 1; i < N && !stop_; ++i)
+  {
+    for (int k = 0; k < K; ++k)
+    {
+      int j = neighbors[(size_t)i * K + k];
+      if (j > 0)
+        addEdge(i, j);
+    }
+  }
+
+  // k-NN graph of clustered instance can be disconnected: the extreme points of each component (left,
+  // right, bottom and top) are linked with their nearest extreme points of other components, which at
+  // least halves the number of components; the dense 1-tree adds better links later
+  while (!stop_)
+  {
+    UnionFind uf(N);
+    for (const auto & e : edges_)
+      uf.unite(e.a, e.b);
+    std::vector<int> extreme(4 * (size_t)N, -1);
+    for (int i = 1; i < N; ++i)
+    {
+      int * x = &extreme[4 * (size_t)uf.find(i)];
+      const Point & p = points[i];
+      if (x[0] < 0 || p.x < points[x[0]].x)
+        x[0] = i;
+      if (x[1] < 0 || p.x > points[x[1]].x)
+        x[1] = i;
+      if (x[2] < 0 || p.y < points[x[2]].y)
+        x[2] = i;
+      if (x[3] < 0 || p.y > points[x[3]].y)
+        x[3] = i;
+    }
+    std::vector<int> ends;
+    int components = 0;
+    for (int i = 1; i < N; ++i)
+    {
+      if (uf.find(i) != i)
+        continue;
+      ++components;
+      const int * x = &extreme[4 * (size_t)i];
+      for (int e = 0; e < 4; ++e)
+        if (std::find(x, x + e, x[e]) == x + e)
+          ends.push_back(x[e]);
+    }
+    if (components <= 1)
+      return;
+    std::vector<Point> pts(ends.size());
+    for (size_t q = 0; q < ends.size(); ++q)
+      pts[q] = points[ends[q]];
+    // at most 3 of 8 nearest extreme points are of the same component
+    std::vector<int> nbrs;
+    int k = findNeighbors(pts, 8, nbrs);
+    for (size_t q = 0; q < ends.size(); ++q)
+    {
+      for (int m = 0; m < k; ++m)
+      {
+        int j = ends[nbrs[q * k + m]];
+        if (uf.find(ends[q]) != uf.find(j))
+          addEdge(ends[q], j);
+      }
+    }
+  }
+}
+
+double LowerBound::sparseOneTree_(const std::vector<double> & pi, std::vector<int> & degree) const
+{
+  std::vector<std::pair<double, int>> order(edges_.size());
+  for (int e = 0; e < (int)edges_.size(); ++e)
+    order[e] = { edges_[e].len + pi[edges_[e].a] + pi[edges_[e].b], e };
+  std::sort(order.begin(), order.end());
+
+  std::fill(degree.begin(), degree.end(), 0);
+  double res = 0;
+  UnionFind uf(N);
+  int joined = 0;
+  for (const auto & o : order)
+  {
+    const auto & e = edges_[o.second];
+    if (!uf.unite(e.a, e.b))
+      continue;
+    res += o.first;
+    ++degree[e.a];
+    ++degree[e.b];
+    if (++joined == N - 2)
+      break;
+  }
+
+  // two cheapest edges of node 0
+  int m0 = -1, m1 = -1;
+  double c0 = DBL_MAX, c1 = DBL_MAX;
+  for (int j = 1; j < N; ++j)
+  {
+    double c = dist(points[0], points[j]) + pi[j];
+    if (c < c0)
+    {
+      c1 = c0; m1 = m0;
+      c0 = c; m0 = j;
+    }
+    else if (c < c1)
+    {
+      c1 = c; m1 = j;
+    }
+  }
+  res += c0 + c1 + 2 * pi[0];
+  degree[0] = 2;
+  ++degree[m0];
+  ++degree[m1];
+
+  return res - 2 * std::accumulate(pi.begin(), pi.end(), 0.0);
+}
+
+double LowerBound::denseOneTree_(const std::vector<double> & pi, std::vector<Edge> & tree) const
+{
+  // Prim's algorithm on nodes 1..N-1
+  std::vector<double> key(N, DBL_MAX);
+  std::vector<int> from(N, -1);
+  std::vector<bool> inTree(N, false);
+  double res = 0;
+  tree.clear();
+  key[1] = 0;
+  for (int step = 1; step < N; ++step)
+  {
+    if (stop_)
+      return 0;
+    int u = -1;
+    for (int v = 1; v < N; ++v)
+      if (!inTree[v] && (u < 0 || key[v] < key[u]))
+        u = v;
+    inTree[u] = true;
+    res += key[u];
+    if (from[u] >= 0)
+      tree.push_back({ from[u], u, dist(points[from[u]], points[u]) });
+    for (int v = 1; v < N; ++v)
+    {
+      if (inTree[v])
+        continue;
+      double c = dist(points[u], points[v]) + pi[u] + pi[v];
+      if (c < key[v])
+      {
+        key[v] = c;
+        from[v] = u;
+      }
+    }
+  }
+
+  double c0 = DBL_MAX, c1 = DBL_MAX;
+  for (int j = 1; j < N; ++j)
+  {
+    double c = dist(points[0], points[j]) + pi[j];
+    if (c < c0)
+    {
+      c1 = c0;
+      c0 = c;
+    }
+    else if (c < c1)
+      c1 = c;
+  }
+  res += c0 + c1 + 2 * pi[0];
+  return res - 2 * std::accumulate(pi.begin(), pi.end(), 0.0);
+}
+
+void LowerBound::run_()
+{
+  buildEdges_();
+
+  std::vector<double> pi(N, 0), bestPi(N, 0);
+  std::vector<int> degree(N);
+  std::vector<Edge> tree;
+  double lambda = 2;
+  const int MAX_ROUNDS = 20;
+  const int MAX_ITERS = 10000;
+  for (int round = 0; round < MAX_ROUNDS && !stop_; ++round)
+  {
+    // subgradient ascent on the candidate graph
+    double bestW = -DBL_MAX;
+    int sinceImprovement = 0;
+    bool tour = false;
+    for (int it = 0; it < MAX_ITERS && lambda > 1e-5 && !stop_; ++it)
+    {
+      double w = sparseOneTree_(pi, degree);
+      if (w > bestW)
+      {
+        bestW = w;
+        bestPi = pi;
+        sinceImprovement = 0;
+      }
+      else if (++sinceImprovement >= 20)
+      {
+        lambda /= 2;
+        sinceImprovement = 0;
+      }
+
+      double norm2 = 0;
+      for (int d : degree)
+        norm2 += (d - 2) * (d - 2);
+      if (norm2 == 0)
+      {
+        tour = true; // the 1-tree is a tour
+        break;
+      }
+      // Polyak step towards the best tour, which is too far to be useful while the tour is poor
+      double ub = upperBound_.load();
+      double gap = ub > w ? std::min(ub - w, 0.05 * fabs(w)) : 0.01 * fabs(w);
+      double t = lambda * gap / norm2;
+      for (int i = 0; i < N; ++i)
+        pi[i] += t * (degree[i] - 2);
+    }
+
+    // the bound on the complete graph is smaller if its 1-tree uses edges not among candidates
+    double d = denseOneTree_(bestPi, tree);
+    if (stop_)
+      break;
+    if (d > value_)
+      value_ = d;
+    int added = 0;
+    for (const auto & e : tree)
+    {
+      if (edgeSet_.insert(std::make_pair(std::min(e.a, e.b), std::max(e.a, e.b))).second)
+      {
+        edges_.push_back(e);
+        ++added;
+      }
+    }
+    if (added == 0 || tour)
+      break;
+    pi = bestPi;
+    lambda = std::max(lambda, 0.1);
+  }
+}
+
+// fixed set of worker threads executing parallel loops
+class ThreadPool
+{
+public:
+  explicit ThreadPool(int threads);
+  ~ThreadPool();
+  int size() const { return (int)threads_.size(); }
+  // calls f(i, worker) for each i in [0, n) on the workers and returns when all calls are finished
+  void parallelFor(int n, const std::function<void(int, int)> & f);
+private:
+  void run_(int worker);
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_, done_;
+  const std::function<void(int, int)> * task_ = nullptr;
+  int n_ = 0;
+  std::atomic<int> next_{ 0 };
+  int busy_ = 0;
+  unsigned round_ = 0;
+  bool stop_ = false;
+};
+
+ThreadPool::ThreadPool(int threads)
+{
+  for (int w = 0; w < std::max(1, threads); ++w)
+    threads_.emplace_back([this, w]() { run_(w); });
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_.notify_all();
+  for (auto & t : threads_)
+    t.join();
+}
+
+void ThreadPool::parallelFor(int n, const std::function<void(int, int)> & f)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  task_ = &f;
+  n_ = n;
+  next_ = 0;
+  busy_ = size();
+  ++round_;
+  start_.notify_all();
+  done_.wait(lock, [this]() { return busy_ == 0; });
+  task_ = nullptr;
+}
+
+void ThreadPool::run_(int worker)
+{
+  unsigned seen = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;)
+  {
+    start_.wait(lock, [&]() { return stop_ || round_ != seen; });
+    if (stop_)
+      return;
+    seen = round_;
+    const auto & f = *task_;
+    int n = n_;
+    lock.unlock();
+    for (int i = next_++; i < n; i = next_++)
+      f(i, worker);
+    lock.lock();
+    if (--busy_ == 0)
+      done_.notify_one();
+  }
+}
+
+// bump allocator for short-lived temporaries, all of them are released at once by reset()
+class Arena
+{
+public:
+  template <class T>
+  T * alloc(size_t n)
+  {
+    size_t bytes = (n * sizeof(T) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+    while (current_ < blocks_.size() && used_ + bytes > blocks_[current_].second)
+    {
+      ++current_;
+      used_ = 0;
+    }
+    if (current_ == blocks_.size())
+    {
+      size_t size = bytes > BLOCK_SIZE ? bytes : BLOCK_SIZE;
+      blocks_.emplace_back(std::unique_ptr<char[]>(new char[size]), size);
+      used_ = 0;
+    }
+    T * res = (T*)(blocks_[current_].first.get() + used_);
+    used_ += bytes;
+    return res;
+  }
+  void reset()
+  {
+    current_ = 0;
+    used_ = 0;
+  }
+private:
+  static const size_t BLOCK_SIZE = 1 << 20;
+  std::vector<std::pair<std::unique_ptr<char[]>, size_t>> blocks_;
+  size_t current_ = 0;
+  size_t used_ = 0;
+};
+
+// population based search with edge assembly crossover (EAX): each individual A is crossed with
+// the next one B in random order. A child is A where the A-edges of one AB-cycle (cycle of alternating
+// edges of A and B) are replaced with its B-edges, and the appeared subtours are greedily merged.
+// The best child replaces A if it is shorter.
+class Eax
+{
+public:
+  Eax(int population, ThreadPool & pool);
+  // fills the population with given tour and locally optimal random tours
+  void init(const Path & seed);
+  // makes one generation, returns false if no individual has been improved for several generations
+  bool generation();
+  // sets the order of res to the best tour
+  void best(Path & res) const;
+  double bestValue() const;
+private:
+  struct Individual
+  {
+    std::vector<int> link; // link[2*c] and link[2*c+1] are the neighbours of city c in the tour
+    double len = 0;
+  };
+  // scratch arrays of applyCycle_ (N entries each), allocated once per cross_
+  struct Subtours
+  {
+    int * sub; // subtour of each city
+    int * nextMember; // next city of the same subtour or -1
+    int * head;
+    int * tail;
+    int * size;
+    int64_t * smallest; // min-heap of size << 32 | subtour, 2N entries, stale entries are skipped
+  };
+  static Individual fromOrder_(const std::vector<int> & order);
+  // makes the best of the children of a and b, returns false if there is no child shorter than a
+  bool cross_(const Individual & a, const Individual & b, Individual & child, std::default_random_engine & rng, Arena & arena) const;
+  // applies AB-cycle to link and merges subtours, returns the change of tour length or DBL_MAX if the
+  // subtours could not be merged
+  double applyCycle_(int * link, const int * cycle, int len, const Subtours & st) const;
+
+  ThreadPool & pool_;
+  std::vector<Arena> arenas_; // of each worker, reset by each crossover
+  std::vector<Individual> pop_;
+  int stall_ = 0; // generations without improvement
+  static const int CHILDREN = 30; // max children per pair of parents
+  static const int MAX_STALL = 10;
+};
+
+Eax::Eax(int population, ThreadPool & pool)
+  : pool_(pool)
+  , arenas_(pool.size())
+  , pop_(std::max(2, population))
+{
+}
+
+Eax::Individual Eax::fromOrder_(const std::vector<int> & order)
+{
+  Individual res;
+  res.link.resize(2 * N);
+  for (int i = 0; i < N; ++i)
+  {
+    int c = order[i];
+    res.link[2 * c] = order[i + 1 < N ? i + 1 : 0];
+    res.link[2 * c + 1] = order[i > 0 ? i - 1 : N - 1];
+    res.len += dist(points[c], points[res.link[2 * c]]);
+  }
+  return res;
+}
+
+void Eax::init(const Path & seed)
+{
+  unsigned base = re();
+  pool_.parallelFor((int)pop_.size(), [&](int i, int)
+  {
+    std::vector<int> order = seed.order();
+    // after the deadline the rest of population are copies of the seed
+    if (i > 0 && !pastDeadline())
+    {
+      std::default_random_engine rng(base + i);
+      std::shuffle(order.begin(), order.end(), rng);
+      Path path = seed;
+      path.setOrder(order);
+      path.neighborTwoOpts();
+      order = path.order();
+    }
+    pop_[i] = fromOrder_(order);
+  });
+}
+
+bool Eax::generation()
+{
+  int P = (int)pop_.size();
+  std::vector<int> perm(P);
+  std::iota(perm.begin(), perm.end(), 0);
+  std::shuffle(perm.begin(), perm.end(), re);
+  unsigned base = re();
+
+  std::vector<Individual> children(P);
+  std::vector<char> better(P, 0);
+  pool_.parallelFor(P, [&](int i, int worker)
+  {
+    if (pastDeadline())
+      return;
+    std::default_random_engine rng(base + i);
+    better[i] = cross_(pop_[perm[i]], pop_[perm[(i + 1) % P]], children[i], rng, arenas_[worker]);
+  });
+
+  bool res = false;
+  for (int i = 0; i < P; ++i)
+  {
+    if (!better[i])
+      continue;
+    pop_[perm[i]] = std::move(children[i]);
+    res = true;
+  }
+  stall_ = res ? 0 : stall_ + 1;
+  return stall_ < MAX_STALL;
+}
+
+bool Eax::cross_(const Individual & a, const Individual & b, Individual & child, std::default_random_engine & rng, Arena & arena) const
+{
+  arena.reset();
+  const int * la = a.link.data();
+  const int * lb = b.link.data();
+
+  // remaining edges of A and B not common to both tours: rest[t][2*c + s], -1 if used
+  int * rest[2] = { arena.alloc<int>(2 * N), arena.alloc<int>(2 * N) };
+  int * nodes = arena.alloc<int>(N);
+  int numNodes = 0;
+  for (int c = 0; c < N; ++c)
+  {
+    for (int s = 0; s < 2; ++s)
+    {
+      int x = la[2 * c + s];
+      rest[0][2 * c + s] = lb[2 * c] == x || lb[2 * c + 1] == x ? -1 : x;
+      x = lb[2 * c + s];
+      rest[1][2 * c + s] = la[2 * c] == x || la[2 * c + 1] == x ? -1 : x;
+    }
+    if (rest[0][2 * c] >= 0 || rest[0][2 * c + 1] >= 0)
+      nodes[numNodes++] = c;
+  }
+  if (numNodes == 0)
+    return false; // same tours
+  std::shuffle(nodes, nodes + numNodes, rng);
+
+  // AB-cycles: cycles[cycleStart[k] .. cycleStart[k+1]) are nodes of k-th cycle, the first edge is from A
+  int * cycles = arena.alloc<int>(2 * N);
+  int * cycleStart = arena.alloc<int>(N + 1);
+  int numCycles = 0;
+  cycleStart[0] = 0;
+  int * path = arena.alloc<int>(2 * N + 1);
+  int * posAt = arena.alloc<int>(2 * N); // index in path of the node with given parity or -1
+  std::fill(posAt, posAt + 2 * N, -1);
+  auto takeEdge = [&](int t, int u)
+  {
+    int * r = rest[t] + 2 * u;
+    int s = r[0] >= 0 && r[1] >= 0 ? (int)(rng() & 1) : (r[0] >= 0 ? 0 : 1);
+    int v = r[s];
+    r[s] = -1;
+    int * rv = rest[t] + 2 * v;
+    if (rv[0] == u)
+      rv[0] = -1;
+    else
+      rv[1] = -1;
+    return v;
+  };
+  for (int q = 0; q < numNodes; ++q)
+  {
+    int s = nodes[q];
+    while (rest[0][2 * s] >= 0 || rest[0][2 * s + 1] >= 0)
+    {
+      int len = 0;
+      path[len++] = s;
+      posAt[2 * s] = 0;
+      for (;;)
+      {
+        int k = len - 1;
+        int t = k & 1; // edges of A go from even positions
+        int v = takeEdge(t, path[k]);
+        int j = posAt[2 * v + ((k + 1) & 1)];
+        if (j < 0)
+        {
+          posAt[2 * v + ((k + 1) & 1)] = len;
+          path[len++] = v;
+          continue;
+        }
+        // path[j..k] is the cycle, started from A-edge if j is even
+        int * cyc = cycles + cycleStart[numCycles];
+        int m = 0;
+        for (int x = (j & 1) ? j + 1 : j; x <= k; ++x)
+          cyc[m++] = path[x];
+        if (j & 1)
+          cyc[m++] = path[j];
+        cycleStart[numCycles + 1] = cycleStart[numCycles] + m;
+        ++numCycles;
+        for (int x = j + 1; x <= k; ++x)
+          posAt[2 * path[x] + (x & 1)] = -1;
+        len = j + 1;
+        if (len == 1)
+          break;
+      }
+      posAt[2 * s] = -1;
+    }
+  }
+
+  // children by single AB-cycles
+  int * order = arena.alloc<int>(numCycles);
+  std::iota(order, order + numCycles, 0);
+  std::shuffle(order, order + numCycles, rng);
+  int * work = arena.alloc<int>(2 * N);
+  Subtours st = { arena.alloc<int>(N), arena.alloc<int>(N), arena.alloc<int>(N), arena.alloc<int>(N), arena.alloc<int>(N),
+    arena.alloc<int64_t>(2 * N) };
+  double bestDelta = -1e-9;
+  for (int q = 0; q < numCycles && q < CHILDREN; ++q)
+  {
+    // the best child found before the deadline is kept
+    if (pastDeadline())
+      break;
+    int k = order[q];
+    std::copy(la, la + 2 * N, work);
+    double delta = applyCycle_(work, cycles + cycleStart[k], cycleStart[k + 1] - cycleStart[k], st);
+    if (delta < bestDelta)
+    {
+      bestDelta = delta;
+      child.link.assign(work, work + 2 * N);
+    }
+  }
+  if (bestDelta >= -1e-9)
+    return false;
+  child.len = a.len + bestDelta;
+  return true;
+}
+
+double Eax::applyCycle_(int * link, const int * cycle, int len, const Subtours & st) const
+{
+  auto unlink = [&](int u, int v)
+  {
+    if (link[2 * u] == v)
+      link[2 * u] = -1;
+    else
+      link[2 * u + 1] = -1;
+  };
+  auto addLink = [&](int u, int v)
+  {
+    if (link[2 * u] < 0)
+      link[2 * u] = v;
+    else
+      link[2 * u + 1] = v;
+  };
+
+  double delta = 0;
+  for (int m = 0; m < len; m += 2)
+  {
+    unlink(cycle[m], cycle[m + 1]);
+    unlink(cycle[m + 1], cycle[m]);
+    delta -= dist(points[cycle[m]], points[cycle[m + 1]]);
+  }
+  for (int m = 1; m < len; m += 2)
+  {
+    int u = cycle[m], v = cycle[m + 1 < len ? m + 1 : 0];
+    addLink(u, v);
+    addLink(v, u);
+    delta += dist(points[u], points[v]);
+  }
+
+  // label subtours, members of each subtour form a linked list
+  int * sub = st.sub;
+  int * nextMember = st.nextMember;
+  int * head = st.head;
+  int * tail = st.tail;
+  int * size = st.size;
+  std::fill(sub, sub + N, -1);
+  int subtours = 0;
+  for (int s = 0; s < N; ++s)
+  {
+    if (sub[s] >= 0)
+      continue;
+    int id = subtours++;
+    head[id] = s;
+    size[id] = 0;
+    int prev = -1, cur = s, last = s;
+    do
+    {
+      sub[cur] = id;
+      ++size[id];
+      nextMember[last] = cur;
+      last = cur;
+      int nx = link[2 * cur] != prev ? link[2 * cur] : link[2 * cur + 1];
+      prev = cur;
+      cur = nx;
+    } while (cur != s);
+    nextMember[last] = -1;
+    tail[id] = last;
+  }
+
+  // merge the smallest subtour with a neighbouring one by 2-opt move until a single tour remains
+  int64_t * smallest = st.smallest;
+  int heapSize = 0;
+  auto push = [&](int id)
+  {
+    smallest[heapSize++] = (int64_t)size[id] << 32 | id;
+    std::push_heap(smallest, smallest + heapSize, std::greater<int64_t>());
+  };
+  for (int id = 0; id < subtours; ++id)
+    push(id);
+  for (int alive = subtours; alive > 1; --alive)
+  {
+    int u0;
+    for (;;)
+    {
+      std::pop_heap(smallest, smallest + heapSize, std::greater<int64_t>());
+      int64_t top = smallest[--heapSize];
+      u0 = (int)(top & 0xffffffff);
+      if (size[u0] == (int)(top >> 32))
+        break;
+    }
+    double best = DBL_MAX;
+    int bu = -1, bu1 = -1, bv = -1, bv1 = -1;
+    auto consider = [&](int u, int u1, int v)
+    {
+      for (int s = 0; s < 2; ++s)
+      {
+        int v1 = link[2 * v + s];
+        double d = dist(points[u], points[v]) + dist(points[u1], points[v1])
+          - dist(points[u], points[u1]) - dist(points[v], points[v1]);
+        if (d < best)
+        {
+          best = d;
+          bu = u; bu1 = u1; bv = v; bv1 = v1;
+        }
+      }
+    };
+    for (int u = head[u0]; u >= 0; u = nextMember[u])
+      for (int s = 0; s < 2; ++s)
+        for (int k = 0; k < K; ++k)
+        {
+          int v = neighbors[(size_t)u * K + k];
+          if (sub[v] != u0)
+            consider(u, link[2 * u + s], v);
+        }
+    // no candidate neighbours outside, the child is given up rather than searched for over all cities
+    if (bu < 0)
+      return DBL_MAX;
+    unlink(bu, bu1);
+    unlink(bu1, bu);
+    unlink(bv, bv1);
+    unlink(bv1, bv);
+    addLink(bu, bv);
+    addLink(bv, bu);
+    addLink(bu1, bv1);
+    addLink(bv1, bu1);
+    delta += best;
+
+    int to = sub[bv];
+    for (int u = head[u0]; u >= 0; u = nextMember[u])
+      sub[u] = to;
+    nextMember[tail[to]] = head[u0];
+    tail[to] = tail[u0];
+    size[to] += size[u0];
+    size[u0] = 0;
+    push(to);
+  }
+  return delta;
+}
+
+void Eax::best(Path & res) const
+{
+  const Individual * b = &pop_[0];
+  for (const auto & x : pop_)
+    if (x.len < b->len)
+      b = &x;
+  std::vector<int> order(N);
+  int prev = -1, cur = 0;
+  for (int i = 0; i < N; ++i)
+  {
+    order[i] = cur;
+    int nx = b->link[2 * cur] != prev ? b->link[2 * cur] : b->link[2 * cur + 1];
+    prev = cur;
+    cur = nx;
+  }
+  res.setOrder(order);
+}
+
+double Eax::bestValue() const
+{
+  double res = DBL_MAX;
+  for (const auto & x : pop_)
+    res = std::min(res, x.len);
+  return res;
+}
+
+// optimizes given number of consecutive parts of the path in parallel starting from given position;
+// each part keeps its first and last cities in place, so the parts can be stitched back
+void optimizeSegments(Path & p, int parts, int offset, ThreadPool & pool)
+{
+  const std::vector<int> & order = p.order();
+  std::vector<int> res(order);
+  unsigned base = re();
+  pool.parallelFor(parts, [&](int k, int)
+  {
+    int from = (int)((long long)k * N / parts);
+    int m = (int)((long long)(k + 1) * N / parts) - from;
+    if (m < 8)
+      return;
+    std::vector<int> cities(m);
+    std::vector<Point> pts(m);
+    for (int i = 0; i < m; ++i)
+    {
+      cities[i] = order[(offset + from + i) % N];
+      pts[i] = points[cities[i]];
+    }
+
+    re.seed(base + k);
+    Path sub(pts, true);
+    double before = sub.value();
+    // a round over all parts makes as many tries as one full path optimization
+    sub.fullOptimize(1.5 * before / (2*m), std::max(100, (int)(25000LL * m / N)));
+    sub.allShortTwoOpts(50);
+    if (sub.value() >= before)
+      return;
+
+    // the fixed edge joins the ends, rotate the cycle to start from the first city towards the last one
+    std::vector<int> so = sub.order();
+    std::rotate(so.begin(), std::find(so.begin(), so.end(), 0), so.end());
+    if (so.back() != m - 1)
+      std::reverse(so.begin() + 1, so.end());
+    assert(so.back() == m - 1);
+    for (int i = 0; i < m; ++i)
+      res[(offset + from + i) % N] = cities[so[i]];
+  });
+  p.setOrder(res);
+}
+
+// multilevel construction: the points are repeatedly coarsened by merging nearest pairs into their centroids
+// down to about given number of points, the coarsest instance is annealed, then the tour is expanded
+// level by level with neighbour 2-opt and Or-opt refinement on each level; returns the order of cities
+std::vector<int> solveMultilevel(int coarsest)
+{
+  struct Level
+  {
+    std::vector<Point> pts;
+    std::vector<int> weight; // number of original points merged in each point
+    std::vector<int> nbrs;
+    int k = 0;
+    std::vector<int> children; // 2 points of the finer level per point, the second is -1 if not merged
+  };
+  std::vector<Level> levels(1);
+  levels[0].pts = points;
+  levels[0].weight.assign(N, 1);
+  levels[0].nbrs = neighbors;
+  levels[0].k = K;
+
+  while ((int)levels.back().pts.size() > coarsest)
+  {
+    const Level & fine = levels.back();
+    int n = (int)fine.pts.size();
+    Level coarse;
+    std::vector<int> merged(n, -1); // point of coarse level
+    std::vector<int> visit(n);
+    std::iota(visit.begin(), visit.end(), 0);
+    std::shuffle(visit.begin(), visit.end(), re);
+    for (int i : visit)
+    {
+      if (merged[i] >= 0)
+        continue;
+      int j = -1;
+      for (int q = 0; q < fine.k && j < 0; ++q)
+      {
+        int c = fine.nbrs[(size_t)i * fine.k + q];
+        if (merged[c] < 0)
+          j = c;
+      }
+      int id = (int)coarse.pts.size();
+      Point pt = fine.pts[i];
+      int w = fine.weight[i];
+      merged[i] = id;
+      if (j >= 0)
+      {
+        merged[j] = id;
+        int wj = fine.weight[j];
+        pt.x = (pt.x * w + fine.pts[j].x * wj) / (w + wj);
+        pt.y = (pt.y * w + fine.pts[j].y * wj) / (w + wj);
+        w += wj;
+      }
+      coarse.pts.push_back(pt);
+      coarse.weight.push_back(w);
+      coarse.children.push_back(i);
+      coarse.children.push_back(j);
+    }
+    if (coarse.pts.size() > 0.95 * n)
+      break; // nothing to merge
+    coarse.k = findNeighbors(coarse.pts, 10, coarse.nbrs);
+    levels.push_back(std::move(coarse));
+  }
+
+  std::vector<int> tour;
+  {
+    const Level & top = levels.back();
+    int n = (int)top.pts.size();
+    Path path(top.pts, false);
+    path.setNeighbors(top.nbrs, top.k);
+    std::vector<int> order = path.order();
+    std::shuffle(order.begin(), order.end(), re);
+    path.setOrder(order);
+    path.neighborTwoOpts();
+    path.fullOptimize(1.5 * path.value() / (2 * n));
+    path.allShortTwoOpts(50);
+    path.neighborTwoOpts();
+    path.neighborOrOpts();
+    tour = path.order();
+  }
+
+  for (int l = (int)levels.size() - 1; l > 0; --l)
+  {
+    const Level & coarse = levels[l];
+    const Level & fine = levels[l - 1];
+    std::vector<int> fineTour;
+    fineTour.reserve(fine.pts.size());
+    for (int c : tour)
+    {
+      int a = coarse.children[2 * c];
+      int b = coarse.children[2 * c + 1];
+      if (b >= 0 && !fineTour.empty()
+        && dist(fine.pts[fineTour.back()], fine.pts[b]) < dist(fine.pts[fineTour.back()], fine.pts[a]))
+        std::swap(a, b);
+      fineTour.push_back(a);
+      if (b >= 0)
+        fineTour.push_back(b);
+    }
+    Path path(fine.pts, false);
+    path.setNeighbors(fine.nbrs, fine.k);
+    path.setOrder(fineTour);
+    for (int r = 0; r < 2; ++r)
+    {
+      path.neighborTwoOpts();
+      path.neighborOrOpts();
+    }
+    tour = path.order();
+  }
+  return tour;
+}
+
+struct Options
+{
+  const char * input = nullptr;
+  // continue from the checkpoint of previous run; it keeps the tours and the engine, not the eax
+  // population, which is rebuilt from the best tour
+  bool resume = false;
+  double checkpointPeriod = 5; // seconds
+  double logPeriod = 1; // seconds between log lines without improvement
+  double gap = 0; // stop as soon as (best - lowerBound) / lowerBound does not exceed it
+  std::string mode = "anneal"; // anneal, eax, segments or multilevel
+  int population = 100; // individuals in eax mode
+  int segments = 0; // parts of the path in segments mode, 0 - for about 1000 cities in each
+  int threads = std::max(1, (int)std::thread::hardware_concurrency());
+  int seed = -1; // of the random engines, -1 - default one
+  double timeLimit = 0; // seconds since start, 0 - unlimited
+  const char * trace = nullptr; // file to write time and value of each improvement to
+  const char * stream = nullptr; // file, named pipe or "-" for stdout to write each improved tour to
+};
+
+bool parseOptions(int argc, char * argv[], Options & o)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string a = argv[i];
+    if (a == "--resume")
+      o.resume = true;
+    else if (a == "--checkpoint-period" && i + 1 < argc)
+      o.checkpointPeriod = atof(argv[++i]);
+    else if (a == "--log-period" && i + 1 < argc)
+      o.logPeriod = atof(argv[++i]);
+    else if (a == "--gap" && i + 1 < argc)
+      o.gap = atof(argv[++i]);
+    else if (a == "--mode" && i + 1 < argc)
+      o.mode = argv[++i];
+    else if (a == "--population" && i + 1 < argc)
+      o.population = atoi(argv[++i]);
+    else if (a == "--segments" && i + 1 < argc)
+      o.segments = atoi(argv[++i]);
+    else if (a == "--seed" && i + 1 < argc)
+      o.seed = atoi(argv[++i]);
+    else if (a == "--time-limit" && i + 1 < argc)
+      o.timeLimit = atof(argv[++i]);
+    else if (a == "--trace" && i + 1 < argc)
+      o.trace = argv[++i];
+    else if (a == "--stream" && i + 1 < argc)
+      o.stream = argv[++i];
+    else if (a == "--threads" && i + 1 < argc)
+      o.threads = std::max(1, atoi(argv[++i]));
+    else if (a.compare(0, 2, "--") != 0 && !o.input)
+      o.input = argv[i];
+    else
+      return false;
+  }
+  return o.input != nullptr && o.checkpointPeriod > 0 && (o.mode == "anneal" || o.mode == "eax" || o.mode == "segments" || o.mode == "multilevel");
 }
 
 int main(int argc, char * argv[])
 {
-  if (argc != 2)
+  auto startTime = std::chrono::steady_clock::now();
+  auto elapsed = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count(); };
+
+  Options opts;
+  if (!parseOptions(argc, argv, opts))
     return 1;
+  if (opts.timeLimit > 0)
+    deadline = startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(opts.timeLimit));
+  if (opts.seed >= 0)
+  {
+    re.seed(opts.seed);
+    srand(opts.seed);
+  }
 
-  std::ifstream f(argv[1]);
-  f >> N;
-  points.resize(N);
-  for (int i = 0; i < N; ++i)
+  if (!readPoints(opts.input))
   {
-    f >> points[i].x >> points[i].y;
+    std::cerr << "cannot read " << opts.input << std::endl;
+    return 1;
   }
+  K = findNeighbors(points, 10, neighbors);
 
   std::ostringstream os;
   os << N << ".sol";
@@ -202,29 +1991,189 @@ int main(int argc, char * argv[])
   std::ifstream start("start/" + os.str());
   if (start)
     best.read(start);
+
+  Path p = best;
+  int firstIter = 0;
+  int bestIter = -1;
+  std::string chkName = std::to_string(N) + ".chk";
+  if (opts.resume)
+  {
+    // a missing or unusable checkpoint starts the search anew
+    Checkpoint c;
+    std::ifstream chk(chkName, std::ifstream::binary);
+    std::default_random_engine engine;
+    bool ok = c.read(chk);
+    if (ok)
+    {
+      std::istringstream rs(c.rng);
+      ok = (bool)(rs >> engine);
+    }
+    if (ok)
+    {
+      re = engine;
+      p.setOrder(std::vector<int>(c.current.begin(), c.current.end()));
+      best.setOrder(std::vector<int>(c.best.begin(), c.best.end()));
+      firstIter = c.header.iter;
+      bestIter = c.header.bestIter;
+      if (opts.mode == "eax")
+        std::cerr << "resuming eax from the best tour of " << chkName << ", the population is rebuilt" << std::endl;
+    }
+    else
+      std::cerr << "cannot resume from " << chkName << ", starting anew" << std::endl;
+  }
   double bestValue = best.value();
 
   std::ofstream log("tsp.log", std::ofstream::app);
+  RateLimiter logLimiter(opts.logPeriod);
+  Checkpointer checkpointer(chkName, opts.checkpointPeriod);
+  // the bound takes a core, it is computed only if asked for or cheap
+  std::unique_ptr<LowerBound> lowerBound;
+  if (opts.gap > 0 || N <= LowerBound::CHEAP_N)
+  {
+    lowerBound.reset(new LowerBound());
+    lowerBound->setUpperBound(bestValue);
+  }
+  auto gapOf = [&](double value)
+  {
+    double lb = lowerBound ? lowerBound->value() : 0;
+    return lb > 0 ? (value - lb) / lb : DBL_MAX;
+  };
+  // "-" while there is no bound
+  auto printBound = [&](std::ostream & os)
+  {
+    double lb = lowerBound ? lowerBound->value() : 0;
+    if (lb > 0)
+      os << "\tlowerBound=" << lb << "\tgap=" << gapOf(bestValue);
+    else
+      os << "\tlowerBound=-\tgap=-";
+  };
+  std::ofstream trace;
+  if (opts.trace)
+  {
+    trace.open(opts.trace);
+    trace.precision(12);
+    trace << elapsed() << '\t' << bestValue << '\n';
+  }
+  // one line per improvement: "tour <seconds> <length> <cities...>", the last complete line is
+  // the best tour so far; opening a named pipe waits for its reader
+  std::ofstream streamFile;
+  std::ostream * stream = nullptr;
+  if (opts.stream)
+  {
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN); // the reader may go away, the search continues
+#endif
+    if (strcmp(opts.stream, "-") == 0)
+      stream = &std::cout;
+    else
+    {
+      streamFile.open(opts.stream);
+      stream = &streamFile;
+    }
+    stream->precision(12);
+  }
+  auto streamBest = [&]()
+  {
+    if (!stream)
+      return;
+    *stream << "tour " << elapsed() << ' ' << bestValue;
+    {
+      BufferedWriter w(*stream);
+      for (int c : best.order())
+      {
+        w.put(' ');
+        w.put(c);
+      }
+      w.put('\n');
+    }
+    stream->flush();
+  };
+  streamBest();
 
-  int A = std::min(50000, 10*N);
-  Path p = best;
-  int bestIter = -1;
-  for (int iter = 0; iter < A; ++iter)
-  {
-    double T = 1.5 * p.value() / (2*N);
-    p.fullOptimize(T);
-    p.allShortTwoOpts(50);
-    double pValue = p.value();
-    log << "iter=" << iter 
-        << "\tlast=" << pValue 
-        << "\tbestIter=" << bestIter
-        << "\tbest=" << bestValue 
-        << std::endl;
-    if (pValue < bestValue)
-    {
-      best = p;
-      bestValue = pValue;
+  // registers the result of an iteration, returns false if the search shall stop
+  auto onIteration = [&](int iter, const Path & current, double value)
+  {
+    bool improved = value < bestValue;
+    if (improved)
+    {
+      best = current;
+      bestValue = value;
       bestIter = iter;
+      if (lowerBound)
+        lowerBound->setUpperBound(bestValue);
+      if (trace.is_open())
+        trace << elapsed() << '\t' << bestValue << '\n';
+      streamBest();
+    }
+    bool flush = logLimiter.ready();
+    if (flush || improved)
+    {
+      log << "iter=" << iter
+          << "\tlast=" << value
+          << "\tbestIter=" << bestIter
+          << "\tbest=" << bestValue;
+      printBound(log);
+      log << '\n';
+    }
+    if (flush)
+      log.flush();
+    checkpointer.publish(iter + 1, bestIter, current, best);
+    if (opts.timeLimit > 0 && elapsed() >= opts.timeLimit)
+      return false;
+    return gapOf(bestValue) > opts.gap;
+  };
+
+  int A = std::min(50000, 10*N);
+  if (opts.mode == "eax")
+  {
+    // iterations are generations, which continue while the population improves
+    ThreadPool pool(opts.threads);
+    Eax eax(opts.population, pool);
+    eax.init(best);
+    Path b = best;
+    for (int iter = firstIter; eax.generation(); ++iter)
+    {
+      eax.best(b);
+      if (!onIteration(iter, b, b.value()))
+        break;
+    }
+  }
+  else if (opts.mode == "segments" || opts.mode == "multilevel")
+  {
+    // iterations are rounds over all parts, the cuts are moved randomly between rounds
+    ThreadPool pool(opts.threads);
+    int parts = opts.segments > 0 ? opts.segments : std::max(opts.threads, N / 1000);
+    parts = std::max(1, std::min(parts, N / 8));
+    int iter = firstIter;
+    bool go = true;
+    if (opts.mode == "multilevel")
+    {
+      // the multilevel tour replaces the current one if shorter and is refined by the rounds
+      Path ml = p;
+      ml.setOrder(solveMultilevel(1000));
+      if (ml.value() < p.value())
+        p = ml;
+      go = onIteration(iter++, p, p.value());
+    }
+    for (; go && iter < A; ++iter)
+    {
+      optimizeSegments(p, parts, std::uniform_int_distribution<>(0, N - 1)(re), pool);
+      go = onIteration(iter, p, p.value());
+    }
+  }
+  else
+  {
+    for (int iter = firstIter; iter < A; ++iter)
+    {
+      double T = 1.5 * p.value() / (2*N);
+      p.fullOptimize(T);
+      // annealing cut by the deadline is not worth polishing unless nothing else is found
+      if (iter > firstIter && pastDeadline())
+        break;
+      p.allShortTwoOpts(50);
+      p.neighborTwoOpts();
+      if (!onIteration(iter, p, p.value()))
+        break;
     }
   }
 
@@ -234,7 +2183,9 @@ int main(int argc, char * argv[])
 
   std::ofstream res("best.txt", std::ofstream::app);
   res.precision(12);
-  res << "N=" << N << "\tbestIter=" << bestIter << "\tmaxIter=" << A << "\tbest=" << bestValue << '\n';
+  res << "N=" << N << "\tbestIter=" << bestIter << "\tmaxIter=" << A << "\tbest=" << bestValue;
+  printBound(res);
+  res << '\n';
 
   std::ofstream sol(os.str());
   sol.precision(12);
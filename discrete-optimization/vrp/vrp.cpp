@@ -1,41 +1,102 @@
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <cfloat>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <string>
+#include <thread>
 #include <vector>
 #include <fstream>
 #include <sstream>
 #include <random>
 
-std::default_random_engine re;
+// each thread has its own engine, seeded by the thread
+thread_local std::default_random_engine re;
 
+// the time window limits the start of the service, a vehicle arriving early waits; travel time equals
+// the distance; the window of the depot limits the duration of the routes
 struct Customer
 {
   int demand = 0;
   double x = 0;
   double y = 0;
+  double ready = 0;
+  double due = DBL_MAX;
+  double service = 0;
 };
 std::vector<Customer> customers;
 
 int V = 0; //number of vehicles
-int C = 0; //capacity of each vehicle
+int C = 0; //default capacity of a vehicle
+int D = 1; //number of depots, the first D customers
+bool timeWindows = false; // some customer has a time window or service time
 
+// vehicle v drives route v from its depot and back
+struct Vehicle
+{
+  int depot = 0;
+  int capacity = 0;
+};
+std::vector<Vehicle> vehicles;
+
+// the first line is "N V C" optionally followed by the number of depots D; a customer line is
+// "demand x y" optionally followed by "ready due service"; the customer lines may be followed by
+// V vehicle lines "capacity depot", otherwise the vehicles have capacity C and are spread over the
+// depots evenly
 void readData(const char * filename)
 {
   std::ifstream f(filename);
   int N;
-  f >> N >> V >> C;
+  std::string line;
+  std::getline(f, line);
+  std::istringstream header(line);
+  header >> N >> V >> C;
+  if (!(header >> D) || D < 1)
+    D = 1;
   customers.resize(N);
   for (auto & c : customers)
   {
-    f >> c.demand >> c.x >> c.y;
+    std::getline(f, line);
+    std::istringstream is(line);
+    is >> c.demand >> c.x >> c.y;
+    if (is >> c.ready >> c.due >> c.service)
+      timeWindows = true;
+  }
+  vehicles.resize(V);
+  for (int v = 0; v < V; ++v)
+  {
+    vehicles[v].capacity = C;
+    vehicles[v].depot = v % D;
+    if (std::getline(f, line))
+    {
+      std::istringstream is(line);
+      Vehicle x;
+      if (is >> x.capacity >> x.depot && x.depot >= 0 && x.depot < D)
+        vehicles[v] = x;
+    }
   }
 }
 
-// returns distance between given two customers
-double dist(int c0, int c1)
+// distances between all customers, precomputed if there are at most MAX_MATRIX of them
+const int MAX_MATRIX = 5000;
+std::vector<float> distMatrix;
+
+// number of candidate neighbours per customer
+int K = 0;
+// neighbors[c*K + k] is the k-th nearest customer (not depot) to customer c
+std::vector<int> neighbors;
+
+double euclid(int c0, int c1)
 {
   const auto & cu0 = customers[c0];
   const auto & cu1 = customers[c1];
@@ -44,276 +105,2784 @@ double dist(int c0, int c1)
   return sqrt(dx*dx + dy*dy);
 }
 
-// path of one vehicle
-class VPath
+// returns distance between given two customers
+inline double dist(int c0, int c1)
 {
-public:
-  double len() const;
-  int stops() const { return (int)path_.size() - 2; }
-  int customerAt(int i) const { return path_[i + 1]; }
-  friend std::ostream & operator <<(std::ostream & o, const VPath & v);
-  // computes the path increase in case of given customer insertion
-  double insertCost(int c) const;
-  // inserts given customer in the path
-  bool insert(int c);
-  // computes the path increase (always negative) in case of customer given by path index deletion
-  double eraseAtCost(int i) const;
-  // erases customer given by path index
-  void eraseAt(int i);
-  // moves customer given by path index into a better path position
-  bool repositionFrom(int i);
-private:
-  int consumed_ = 0;
-  std::vector<int> path_ = { 0, 0 };
-};
+  if (!distMatrix.empty())
+    return distMatrix[(size_t)c0 * customers.size() + c1];
+  return euclid(c0, c1);
+}
 
-double VPath::len() const
+// fills distMatrix and neighbors lists of k nearest customers
+void prepareDistances(int k)
 {
-  double res = 0;
-  for (int i = 0; i + 1 < path_.size(); ++i)
-    res += dist(path_[i], path_[i + 1]);
-  return res;
+  int n = (int)customers.size();
+  if (n <= MAX_MATRIX)
+  {
+    distMatrix.resize((size_t)n * n);
+    for (int a = 0; a < n; ++a)
+    {
+      for (int b = 0; b < n; ++b)
+        distMatrix[(size_t)a * n + b] = (float)euclid(a, b);
+    }
+  }
+
+  K = std::max(0, std::min(k, n - D - 1));
+  neighbors.assign((size_t)n * K, 0);
+  std::vector<std::pair<double, int>> cand;
+  for (int a = D; a < n; ++a)
+  {
+    cand.clear();
+    for (int b = D; b < n; ++b)
+    {
+      if (b != a)
+        cand.emplace_back(dist(a, b), b);
+    }
+    std::partial_sort(cand.begin(), cand.begin() + K, cand.end());
+    for (int q = 0; q < K; ++q)
+      neighbors[(size_t)a * K + q] = cand[q].second;
+  }
 }
 
-std::ostream & operator <<(std::ostream & o, const VPath & v)
+// weight of a unit of excess demand the penalty search starts with: a return trip to the customer
+// farthest from its nearest depot per the largest demand
+double initialPenalty()
 {
-  for (int c : v.path_)
-    o << c << ' ';
-  return o;
+  double far = 0;
+  int demand = 1;
+  for (int c = D; c < (int)customers.size(); ++c)
+  {
+    double near = DBL_MAX;
+    for (int d = 0; d < D; ++d)
+      near = std::min(near, dist(c, d));
+    far = std::max(far, 2 * near);
+    demand = std::max(demand, customers[c].demand);
+  }
+  return std::max(far / demand, 1e-6);
 }
 
-double VPath::insertCost(int c) const
+// random keys of the locations and vehicles (after the locations), the signature of a route is the
+// xor of the keys of its vehicle and of its edges (Zobrist hashing)
+std::vector<uint64_t> zobrist;
+
+void prepareKeys()
 {
-  const auto & cu = customers[c];
-  if (consumed_ + cu.demand > C)
-    return DBL_MAX;
+  std::mt19937_64 gen(1);
+  zobrist.resize(customers.size() + V);
+  for (auto & key : zobrist)
+    key = gen();
+}
 
-  double res = DBL_MAX;
-  for (int i = 0; i + 1 < path_.size(); ++i)
+inline uint64_t edgeKey(int a, int b)
+{
+  return zobrist[a] * (zobrist[b] | 1);
+}
+
+// Evaluations of customer moves keyed by the moved customers and the signatures of the routes they
+// involve: the random moves keep proposing the same moves, while those routes stay the same, the
+// cached cost is given to the acceptance policy again instead of a new evaluation, so the search goes
+// the same way. The table is direct-mapped, a new entry takes the slot of the old one.
+class MoveCache
+{
+public:
+  // cost change and the node to insert after (-1 - the move is not possible); a swap has two choices,
+  // both customers with after and after1, or only the second one with after2
+  struct Entry
   {
-    double x = dist(path_[i], c) + dist(c, path_[i + 1]) - dist(path_[i], path_[i + 1]);
-    if (x < res)
-      res = x;
+    uint64_t key = 0;
+    double cost = 0;
+    double cost2 = 0;
+    int after = -1;
+    int after1 = -1;
+    int after2 = -1;
+  };
+  // kind tells the moves apart, the penalty weight is a part of their costs
+  static uint64_t key(int kind, int c0, int c1, uint64_t route0, uint64_t route1, double penalty)
+  {
+    uint64_t weight;
+    memcpy(&weight, &penalty, sizeof(weight));
+    uint64_t x = ((uint64_t)kind << 56) ^ ((uint64_t)c0 << 28) ^ (uint64_t)c1;
+    return mix_(route0 ^ mix_(route1 ^ mix_(x ^ mix_(weight))));
   }
-  return res;
-}
+  // the move evaluated before on the same routes or nullptr
+  const Entry * find(uint64_t key)
+  {
+    ++lookups_;
+    const Entry & e = table_[key >> (64 - BITS)];
+    if (e.key != key)
+      return nullptr;
+    ++hits_;
+    return &e;
+  }
+  Entry & store(uint64_t key)
+  {
+    Entry & e = table_[key >> (64 - BITS)];
+    e.key = key;
+    return e;
+  }
+  // adds the counts of the thread to the totals
+  void flush()
+  {
+    lookups += lookups_;
+    hits += hits_;
+    lookups_ = hits_ = 0;
+  }
+  static std::atomic<long long> lookups, hits;
+private:
+  static const int BITS = 14;
+  // finalizer of MurmurHash3
+  static uint64_t mix_(uint64_t x)
+  {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    return x ^ (x >> 33);
+  }
+  std::vector<Entry> table_ = std::vector<Entry>((size_t)1 << BITS);
+  long long lookups_ = 0;
+  long long hits_ = 0;
+};
+
+std::atomic<long long> MoveCache::lookups(0);
+std::atomic<long long> MoveCache::hits(0);
 
-bool VPath::insert(int c)
+thread_local MoveCache moveCache;
+
+// decides whether a move of the solution is taken; the policies keep their own estimate of the
+// current cost, which is reset at the start of each batch of moves
+class Acceptance
 {
-  const auto & cu = customers[c];
-  if (consumed_ + cu.demand > C)
-    return false;
+public:
+  virtual ~Acceptance() {}
+  // starts a batch of moves from the solution of given cost, progress is the elapsed part of the run in [0, 1]
+  virtual void start(double /*progress*/, double cost) { cur_ = cost; }
+  // returns whether a move changing the cost by delta is taken
+  virtual bool accept(double delta) = 0;
+protected:
+  bool take_(bool ok, double delta)
+  {
+    if (ok)
+      cur_ += delta;
+    return ok;
+  }
+  double cur_ = 0;
+};
+
+// only improving moves
+class GreedyAcceptance : public Acceptance
+{
+public:
+  bool accept(double delta) override { return take_(delta < 0, delta); }
+};
+
+// simulated annealing, the temperature falls geometrically from a fraction of the average edge length
+class AnnealingAcceptance : public Acceptance
+{
+public:
+  void start(double progress, double cost) override
+  {
+    Acceptance::start(progress, cost);
+    T_ = START * cost / customers.size() * pow(END / START, progress);
+  }
+  bool accept(double delta) override
+  {
+    if (delta < 0)
+      return take_(true, delta);
+    return take_(T_ > 0 && prob_(re) < exp(-delta / T_), delta);
+  }
+private:
+  static constexpr double START = 1.0;
+  static constexpr double END = 0.01;
+  double T_ = 0;
+  std::uniform_real_distribution<> prob_;
+};
 
-  double minIncr = DBL_MAX;
-  int minPos = -1;
-  for (int i = 0; i + 1 < path_.size(); ++i)
+// record-to-record travel: any move keeping the cost within a deviation of the record, the deviation
+// falls linearly to zero
+class RecordAcceptance : public Acceptance
+{
+public:
+  void start(double progress, double cost) override
   {
-    double x = dist(path_[i], c) + dist(c, path_[i + 1]) - dist(path_[i], path_[i + 1]);
-    if (x < minIncr)
-    {
-      minIncr = x;
-      minPos = i;
-    }
+    Acceptance::start(progress, cost);
+    if (cost < record_)
+      record_ = cost;
+    deviation_ = DEVIATION * (1 - progress);
   }
-  path_.insert(path_.begin() + minPos + 1, c);
-  consumed_ += cu.demand;
-  return true;
+  bool accept(double delta) override
+  {
+    bool ok = delta < 0 || cur_ + delta < record_ * (1 + deviation_);
+    take_(ok, delta);
+    if (cur_ < record_)
+      record_ = cur_;
+    return ok;
+  }
+private:
+  static constexpr double DEVIATION = 0.02;
+  double record_ = DBL_MAX;
+  double deviation_ = 0;
+};
+
+// late acceptance hill climbing: a move is taken if the result is not worse than the current cost
+// a fixed number of moves ago
+class LateAcceptance : public Acceptance
+{
+public:
+  void start(double progress, double cost) override
+  {
+    Acceptance::start(progress, cost);
+    if (history_.empty())
+      history_.assign(LENGTH, cost);
+  }
+  bool accept(double delta) override
+  {
+    double & h = history_[k_];
+    bool ok = delta < 0 || cur_ + delta <= h;
+    take_(ok, delta);
+    h = cur_;
+    k_ = (k_ + 1) % LENGTH;
+    return ok;
+  }
+private:
+  static const int LENGTH = 2000;
+  std::vector<double> history_;
+  int k_ = 0;
+};
+
+// creates the policy by name: greedy, sa, rrt or lahc; nullptr for unknown name
+std::unique_ptr<Acceptance> makeAcceptance(const std::string & name)
+{
+  if (name == "greedy")
+    return std::unique_ptr<Acceptance>(new GreedyAcceptance);
+  if (name == "sa")
+    return std::unique_ptr<Acceptance>(new AnnealingAcceptance);
+  if (name == "rrt")
+    return std::unique_ptr<Acceptance>(new RecordAcceptance);
+  if (name == "lahc")
+    return std::unique_ptr<Acceptance>(new LateAcceptance);
+  return nullptr;
+}
+
+// fixed set of worker threads executing parallel loops
+class ThreadPool
+{
+public:
+  explicit ThreadPool(int threads);
+  ~ThreadPool();
+  int size() const { return (int)threads_.size(); }
+  // calls f(i, worker) for each i in [0, n) on the workers and returns when all calls are finished
+  void parallelFor(int n, const std::function<void(int, int)> & f);
+private:
+  void run_(int worker);
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_, done_;
+  const std::function<void(int, int)> * task_ = nullptr;
+  int n_ = 0;
+  std::atomic<int> next_{ 0 };
+  int busy_ = 0;
+  unsigned round_ = 0;
+  bool stop_ = false;
+};
+
+ThreadPool::ThreadPool(int threads)
+{
+  for (int w = 0; w < std::max(1, threads); ++w)
+    threads_.emplace_back([this, w]() { run_(w); });
 }
 
-double VPath::eraseAtCost(int i) const
+ThreadPool::~ThreadPool()
 {
-  assert(i >= 0 && i + 2 < path_.size());
-  return dist(path_[i], path_[i + 2])
-    - dist(path_[i], path_[i + 1]) 
-    - dist(path_[i + 1], path_[i + 2]);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_.notify_all();
+  for (auto & t : threads_)
+    t.join();
 }
 
-void VPath::eraseAt(int i)
+void ThreadPool::parallelFor(int n, const std::function<void(int, int)> & f)
 {
-  assert(i >= 0 && i + 2 < path_.size());
-  consumed_ -= customers[path_[i + 1]].demand;
-  path_.erase(path_.begin() + i + 1);
+  std::unique_lock<std::mutex> lock(mutex_);
+  task_ = &f;
+  n_ = n;
+  next_ = 0;
+  busy_ = size();
+  ++round_;
+  start_.notify_all();
+  done_.wait(lock, [this]() { return busy_ == 0; });
+  task_ = nullptr;
 }
 
-bool VPath::repositionFrom(int oldPos)
+void ThreadPool::run_(int worker)
 {
-  int c = customerAt(oldPos);
-  double minIncr = DBL_MAX;
-  int minPos = -1;
-  for (int i = 0; i + 1 < path_.size(); ++i)
+  unsigned seen = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;)
   {
-    if (i == oldPos || i == oldPos + 1)
-      continue;
-    double x = dist(path_[i], c) + dist(c, path_[i + 1]) - dist(path_[i], path_[i + 1]);
-    if (x < minIncr)
-    {
-      minIncr = x;
-      minPos = i;
-    }
+    start_.wait(lock, [&]() { return stop_ || round_ != seen; });
+    if (stop_)
+      return;
+    seen = round_;
+    const auto & f = *task_;
+    int n = n_;
+    lock.unlock();
+    for (int i = next_++; i < n; i = next_++)
+      f(i, worker);
+    lock.lock();
+    if (--busy_ == 0)
+      done_.notify_one();
   }
-  if (eraseAtCost(oldPos) + minIncr >= 0)
-    return false;
-  if (minPos > oldPos)
-    --minPos;
-  path_.erase(path_.begin() + oldPos + 1);
-  path_.insert(path_.begin() + minPos + 1, c);
-  return true;
 }
 
+// All routes are kept in flat arrays indexed by node: customer c is node c, route v has its own depot
+// nodes, the start N + 2v and the end N + 2v + 1 (N - number of customers with the depot). Moves are
+// pointer updates followed by one pass over each changed route refreshing the cached positions and
+// prefix sums, a copy of a solution is a copy of one array.
 class Solution
 {
 public:
-  Solution();
+  // builds the best of Clarke-Wright savings, regret-2/3 insertion and insertion by decreasing demand
+  // (which packs tight instances best) solutions; if none fits the capacity and time windows, the
+  // customers left by regret-3 are put into the routes with most free capacity regardless of them;
+  // the work is shared with the pool if given
+  explicit Solution(ThreadPool * pool = nullptr);
+  // cuts given order of all customers (giant tour) into routes by Split, the customers of routes above V
+  // are inserted by regret-3; with more depots, vehicle sizes or time windows the customers are inserted
+  // in the order into their cheapest positions instead; the ones left are put in as by the other
+  // constructor
+  explicit Solution(const std::vector<int> & tour);
+  // the total is kept up to date by every change of the routes
   double cost() const;
+  // whether all routes keep the capacity and time windows
+  bool feasible() const;
+  // Routes may exceed the capacity at a cost of weight per unit of excess demand, 0 (the default) keeps
+  // the capacity a hard constraint. The moves, local search and insertions then compare the cost with
+  // the penalty, cost() stays the length.
+  void setPenalty(double weight);
+  double penalty() const { return penalty_; }
+  // sum of the demand over the capacity of all routes
+  int excess() const { return excess_; }
+  // relocations and local search with 10 and 100 times the weight, then the customers saving most are
+  // removed from the routes still over the capacity and inserted by regret-3 within it; the penalty is
+  // switched off; false if some do not fit, they are put in regardless
+  bool repair();
+  // the customers of all routes one after another
+  std::vector<int> giantTour() const;
+  // share of the customers followed by a different neighbour (either direction) in the other solution
+  double brokenPairs(const Solution & other) const;
   void print(std::ostream & os) const;
-  void moveCustomers(int tries);
-  void swapCustomers(int tries);
+  // writes the routes on one line, each preceded by " |"
+  void printRoutes(std::ostream & os) const;
+  void moveCustomers(int tries, Acceptance & acceptance);
+  void swapCustomers(int tries, Acceptance & acceptance);
+  // moves each customer into the cheapest position of the routes of its K nearest customers if that
+  // shortens the solution, until no such move is left
+  void relocateCustomers();
+  // applies route improvement operators until none of them shortens the solution
+  void localSearch();
+  // solves each route whose customers changed since the last call as a TSP, the routes are
+  // distributed over the workers of the pool if given
+  void optimizeRoutes(ThreadPool * pool = nullptr);
+
+  // ruin operators remove count customers (or all if fewer) and append them to removed:
+  // random ones, ones saving most (randomized) and ones near a random customer
+  void ruinRandom(int count, std::vector<int> & removed);
+  void ruinWorst(int count, std::vector<int> & removed);
+  void ruinRelated(int count, std::vector<int> & removed);
+  // inserts removed customers by regret-k heuristic, k = 1 is greedy cheapest insertion;
+  // returns false if some customers do not fit, they remain in removed
+  bool recreate(std::vector<int> & removed, int k, ThreadPool * pool = nullptr);
 
 private:
-  std::vector<VPath> vs_;
+  struct Node
+  {
+    int next = -1;
+    int prev = -1;
+    int route = -1; // -1 - not in a route
+    int pos = 0; // the start depot has 0
+    int load = 0; // demand from the start of the route up to the node
+    double len = 0; // length from the start of the route up to the node
+    // with time windows: the earliest start of the service given the nodes before and the latest one
+    // keeping the nodes after feasible (Savelsbergh), so a change between two nodes is checked by
+    // going from the first to the second over the new nodes only
+    double early = 0;
+    double late = DBL_MAX;
+  };
+
+  int first_(int v) const { return n_ + 2 * v; }
+  int last_(int v) const { return n_ + 2 * v + 1; }
+  int loc_(int x) const { return x < n_ ? x : vehicles[(x - n_) / 2].depot; }
+  double d_(int a, int b) const { return dist(loc_(a), loc_(b)); }
+  // length of the edge from given node to the next one
+  double edge_(int a) const { return nodes_[nodes_[a].next].len - nodes_[a].len; }
+  int load_(int v) const { return nodes_[last_(v)].load; }
+  int cap_(int v) const { return vehicles[v].capacity; }
+  // whether route v may have given load and the penalty of its excess
+  bool fits_(int v, int load) const { return load <= cap_(v) || penalty_ > 0; }
+  double overload_(int v, int load) const { return penalty_ * std::max(0, load - cap_(v)); }
+  int stops_(int v) const { return nodes_[last_(v)].pos - 1; }
+  int route_(int c) const { return nodes_[c].route; }
+
+  // empties all routes
+  void reset_();
+  void link_(int a, int b)
+  {
+    nodes_[a].next = b;
+    nodes_[b].prev = a;
+  }
+  // recomputes route, positions and prefix sums along the route and the total cost
+  void refresh_(int v);
+  // start of the service at b when the service at a starts at t
+  double arrive_(double t, int a, int b) const
+  {
+    return std::max(customers[loc_(b)].ready, t + customers[loc_(a)].service + d_(a, b));
+  }
+  // whether the route may go from node a over count nodes of seq to node b within the time windows,
+  // the nodes up to a and from b on stay as they are
+  bool timeOk_(int a, const int * seq, int count, int b) const;
+  // whether moving the segment s..e of a route after node x of the same route, reversed if so, keeps
+  // the time windows
+  bool moveTimeOk_(int s, int e, int x, bool reversed) const;
+  // reverses the order of the nodes from..to without linking them to the rest
+  void flip_(int from, int to);
+
+  // computes the cost increase of the cheapest insertion of given customer into route v and the node
+  // to insert after (-1 if the route cannot take it), the capacity and time windows are ignored if force;
+  // the costs here and below include the change of the excess penalty
+  double insertCost_(int c, int v, int & after, bool force = false) const;
+  // all insertion positions in route order with the coordinates of their edges, a snapshot for
+  // evaluating the insertions of many customers at once
+  struct Positions
+  {
+    std::vector<float> x0, y0, x1, y1, len;
+    std::vector<int> after; // the node to insert after
+    std::vector<int> begin; // route v has the positions begin[v] .. begin[v + 1] - 1
+  };
+  void listPositions_(Positions & p) const;
+  // computes for all routes the cost increase of the cheapest insertion of given customer and the node
+  // to insert after (-1 if the route cannot take it): one pass over the coordinate arrays, written to
+  // be vectorized, evaluates all positions, the routes with enough capacity are searched for the best
+  void insertCosts_(int c, const Positions & p, double * cost, int * after) const;
+  void insertAfter_(int c, int after);
+  void insertBest_(int c, int v, bool force);
+  // computes the cost increase (always negative) in case of given customer removal
+  double eraseCost_(int c) const;
+  // eraseCost_ and insertCost_ of moving a customer into another route, through the move cache
+  double moveCost_(int c, int v, int & after) const;
+  void remove_(int c);
+  // moves given customer into a better position of its route
+  bool reposition_(int c);
+
+  // Route improvement operators, each applies improving moves while there are any and returns
+  // true if the routes changed. Capacity is checked with prefix demand sums.
+
+  // 2-opt: reverses the part of the route between two edges
+  bool twoOpt_(int v);
+  // Or-opt: moves a segment of 1-3 customers to another position of the route, possibly reversed
+  bool orOpt_(int v);
+  // 2-opt*: exchanges the tails of two routes
+  bool twoOptStar_(int v, int w);
+  // CROSS-exchange: swaps segments of up to 3 customers (one may be empty) between two routes
+  bool crossExchange_(int v, int w);
+
+  // Clarke-Wright savings merging routes along candidate neighbour pairs, the smallest routes above
+  // V are dissolved and their customers inserted by regret-3; false if some customers do not fit or
+  // there are more depots or vehicle sizes
+  bool buildSavings_();
+  // inserts customers by decreasing demand into their cheapest routes; false if some do not fit
+  bool buildByDemand_();
+  // inserts customers in given order into their cheapest routes, the ones that do not fit are appended
+  // to removed
+  void buildInOrder_(const std::vector<int> & order, std::vector<int> & removed);
+  // inserts customers by regret-3, the ones that do not fit go into the routes with most free capacity
+  // regardless of the capacity and time windows
+  void insertForced_(std::vector<int> & removed, ThreadPool * pool);
+  // cuts the giant tour into at most V routes of one depot and vehicle size optimally (Split); if more
+  // routes are needed, the customers of the least loaded ones are appended to removed; false if there
+  // are more depots, vehicle sizes or time windows
+  bool split_(const std::vector<int> & tour, std::vector<int> & removed);
+  // whether a route from given depot visiting given customers keeps the time windows
+  static bool pathTimeOk_(const std::vector<int> & path, int depot);
+  // orders the customers of a route: exact dynamic programming for at most MAX_EXACT of them without
+  // time windows, otherwise 2-opt and Or-opt with don't-look bits
+  static void optimizeOrder_(std::vector<int> & path, int depot);
+  static const int MAX_EXACT = 8; // 2^n n^2 steps, with 12 the pass took most of the search time
+  // sum of the edge lengths along all routes
+  double length_() const;
+
+  double cost_ = 0;
+  double penalty_ = 0;
+  int excess_ = 0;
+  std::vector<char> changed_; // the customers of the route changed since optimizeRoutes
+  std::vector<unsigned> version_; // counts the refreshes of each route
+  std::vector<uint64_t> signature_; // of each route, for the move cache
+  std::vector<unsigned> clean_; // versions of the routes the last local search ended with
+  int n_ = (int)customers.size();
+  std::vector<Node> nodes_;
 };
 
-Solution::Solution()
-  : vs_( V )
+Solution::Solution(ThreadPool * pool)
 {
-  std::vector<std::pair<int, int>> demandCust;
-  for (int c = 1; c < customers.size(); ++c)
+  std::vector<int> all;
+  for (int c = D; c < (int)customers.size(); ++c)
+    all.push_back(c);
+
+  double bestCost = DBL_MAX;
+  std::vector<Node> best;
+  for (int method = 0; method < 4; ++method)
   {
-    demandCust.emplace_back(customers[c].demand, c);
+    reset_();
+    std::vector<int> removed = all;
+    bool ok = method == 0 ? buildSavings_() : method == 3 ? buildByDemand_() : recreate(removed, method + 1, pool);
+    if (ok && cost() < bestCost)
+    {
+      bestCost = cost();
+      best = nodes_;
+    }
   }
-  std::sort(demandCust.rbegin(), demandCust.rend());
 
-  for (int i = 0; i < demandCust.size(); ++i)
+  if (bestCost < DBL_MAX)
   {
-    int c = demandCust[i].second;
-    double minCost = DBL_MAX;
-    int bestV = -1;
+    nodes_ = best;
+    cost_ = bestCost;
+    excess_ = 0;
+    // the signatures are of the last built solution
     for (int v = 0; v < V; ++v)
+      refresh_(v);
+  }
+  else
+  {
+    reset_();
+    std::vector<int> removed = all;
+    insertForced_(removed, pool);
+  }
+}
+
+Solution::Solution(const std::vector<int> & tour)
+{
+  reset_();
+  std::vector<int> removed;
+  if (!split_(tour, removed))
+    buildInOrder_(tour, removed);
+  if (!removed.empty())
+    insertForced_(removed, nullptr);
+}
+
+void Solution::insertForced_(std::vector<int> & removed, ThreadPool * pool)
+{
+  recreate(removed, 3, pool);
+  for (int c : removed)
+  {
+    int v = 0;
+    for (int w = 1; w < V; ++w)
+    {
+      if (cap_(w) - load_(w) > cap_(v) - load_(v))
+        v = w;
+    }
+    insertBest_(c, v, true);
+  }
+  removed.clear();
+}
+
+bool Solution::split_(const std::vector<int> & tour, std::vector<int> & removed)
+{
+  if (D > 1 || timeWindows)
+    return false;
+  for (int v = 1; v < V; ++v)
+  {
+    if (cap_(v) != cap_(0))
+      return false;
+  }
+  // t_i = tour[i - 1], prefix sums of the demand and of the length along the tour
+  int m = (int)tour.size();
+  std::vector<long long> load(m + 1, 0);
+  std::vector<double> len(m + 1, 0);
+  for (int i = 1; i <= m; ++i)
+  {
+    load[i] = load[i - 1] + customers[tour[i - 1]].demand;
+    len[i] = i > 1 ? len[i - 1] + dist(tour[i - 2], tour[i - 1]) : 0;
+  }
+  // Route t_i+1 .. t_j costs dist(0, t_i+1) + len[j] - len[i+1] + dist(t_j, 0), so the best cut before j
+  // minimizes cost[i] + dist(0, t_i+1) - len[i+1] over the i the capacity allows; that window slides
+  // with j and its minimum is kept in a monotone queue, one cutting takes O(m) (Vidal's linear Split).
+  // The cost of a row comes from the previous row (one more route) or from itself (any number).
+  std::vector<int> queue(m + 1);
+  std::vector<double> key(m + 1);
+  auto cut = [&](const double * from, double * cost, int * pred)
+  {
+    int head = 0, tail = 0;
+    for (int j = 1; j <= m; ++j)
     {
-      double cost = vs_[v].insertCost(c);
-      if (cost < minCost)
+      int i = j - 1;
+      if (from[i] < DBL_MAX)
       {
-        minCost = cost;
-        bestV = v;
+        key[i] = from[i] + dist(0, tour[i]) - len[i + 1];
+        while (tail > head && key[queue[tail - 1]] >= key[i])
+          --tail;
+        queue[tail++] = i;
       }
+      while (head < tail && load[j] - load[queue[head]] > cap_(0))
+        ++head;
+      if (head < tail)
+      {
+        cost[j] = key[queue[head]] + len[j] + dist(tour[j - 1], 0);
+        pred[j] = queue[head];
+      }
+    }
+  };
+  auto assign = [&](int v, int i, int j)
+  {
+    int a = first_(v);
+    for (int k = i; k < j; ++k)
+    {
+      link_(a, tour[k]);
+      a = tour[k];
+    }
+    link_(a, last_(v));
+    changed_[v] = 1;
+    refresh_(v);
+  };
+
+  // any number of routes first, usually it fits the fleet
+  std::vector<double> cost(m + 1, DBL_MAX);
+  std::vector<int> pred(m + 1, 0);
+  cost[0] = 0;
+  cut(cost.data(), cost.data(), pred.data());
+  if (cost[m] == DBL_MAX)
+  {
+    removed.insert(removed.end(), tour.begin(), tour.end());
+    return true;
+  }
+  std::vector<std::pair<long long, int>> routes; // load and end
+  for (int j = m; j > 0; j = pred[j])
+    routes.emplace_back(load[j] - load[pred[j]], j);
+  if ((int)routes.size() <= V)
+  {
+    for (int v = 0; v < (int)routes.size(); ++v)
+      assign(v, pred[routes[v].second], routes[v].second);
+    return true;
+  }
+
+  // row k - exactly k routes, O(m V)
+  std::vector<double> rows((size_t)(V + 1) * (m + 1), DBL_MAX);
+  std::vector<int> rowPred((size_t)(V + 1) * (m + 1), 0);
+  rows[0] = 0;
+  int best = 0;
+  for (int k = 1; k <= V; ++k)
+  {
+    cut(&rows[(size_t)(k - 1) * (m + 1)], &rows[(size_t)k * (m + 1)], &rowPred[(size_t)k * (m + 1)]);
+    if (rows[(size_t)k * (m + 1) + m] < rows[(size_t)best * (m + 1) + m])
+      best = k;
+  }
+  if (best == 0)
+  {
+    // the fullest routes of the free cutting stay
+    std::sort(routes.rbegin(), routes.rend());
+    for (int v = 0; v < (int)routes.size(); ++v)
+    {
+      int i = pred[routes[v].second], j = routes[v].second;
+      if (v < V)
+        assign(v, i, j);
+      else
+        removed.insert(removed.end(), tour.begin() + i, tour.begin() + j);
     }
-    vs_[bestV].insert(c);
+    return true;
   }
+  for (int k = best, j = m; k > 0; --k)
+  {
+    int i = rowPred[(size_t)k * (m + 1) + j];
+    assign(k - 1, i, j);
+    j = i;
+  }
+  return true;
 }
 
-double Solution::cost() const
+void Solution::reset_()
 {
-  double res = 0;
-  for (const auto & v : vs_)
+  nodes_.assign(customers.size() + 2 * V, Node());
+  cost_ = 0;
+  excess_ = 0;
+  changed_.assign(V, 1);
+  version_.assign(V, 1);
+  clean_.assign(V, 0);
+  signature_.assign(V, 0);
+  for (int v = 0; v < V; ++v)
   {
-    res += v.len();
+    link_(first_(v), last_(v));
+    refresh_(v);
   }
-  return res;
 }
 
-void Solution::print(std::ostream & os) const
+void Solution::refresh_(int v)
 {
-  os.precision(12);
-  os << cost() << " 0\n";
+  double old = nodes_[last_(v)].len;
+  int oldLoad = nodes_[last_(v)].load;
+  ++version_[v];
+  int a = first_(v);
+  Node * na = &nodes_[a];
+  na->route = v;
+  na->pos = 0;
+  na->load = 0;
+  na->len = 0;
+  na->early = customers[vehicles[v].depot].ready;
+  uint64_t signature = zobrist[n_ + v];
+  for (int locA = loc_(a); a != last_(v); )
+  {
+    int b = na->next, locB = loc_(b);
+    Node * nb = &nodes_[b];
+    nb->route = v;
+    nb->pos = na->pos + 1;
+    nb->load = na->load + customers[locB].demand;
+    nb->len = na->len + dist(locA, locB);
+    if (timeWindows)
+      nb->early = arrive_(na->early, a, b);
+    signature ^= edgeKey(locA, locB);
+    a = b;
+    locA = locB;
+    na = nb;
+  }
+  signature_[v] = signature;
+  cost_ += nodes_[a].len - old;
+  excess_ += std::max(0, nodes_[a].load - cap_(v)) - std::max(0, oldLoad - cap_(v));
 
-  for (const auto & v : vs_)
+  if (timeWindows)
   {
-    os << v << '\n';
+    nodes_[a].late = customers[vehicles[v].depot].due;
+    for (int b = a; b != first_(v); b = a)
+    {
+      a = nodes_[b].prev;
+      nodes_[a].late = std::min(customers[loc_(a)].due, nodes_[b].late - d_(a, b) - customers[loc_(a)].service);
+    }
   }
-  os << std::endl;
 }
 
-void Solution::moveCustomers(int tries)
+bool Solution::timeOk_(int a, const int * seq, int count, int b) const
 {
-  std::uniform_int_distribution<> path(0, V - 1);
-  for (int t = 0; t < tries; ++t)
+  if (!timeWindows)
+    return true;
+  double t = nodes_[a].early;
+  for (int k = 0; k < count; ++k)
   {
-    int fromPath = path(re);
-    int toPath = path(re);
-    auto & fp = vs_[fromPath];
-    auto & tp = vs_[toPath];
-    int fromStops = fp.stops();
-    if (fromStops <= 0)
-      continue;
-    int i = std::uniform_int_distribution<>(0, fromStops - 1)(re);
-    int c = fp.customerAt(i);
-    if (fromPath == toPath)
+    t = arrive_(t, a, seq[k]);
+    a = seq[k];
+    if (t > customers[loc_(a)].due)
+      return false;
+  }
+  return arrive_(t, a, b) <= nodes_[b].late;
+}
+
+bool Solution::moveTimeOk_(int s, int e, int x, bool reversed) const
+{
+  if (!timeWindows)
+    return true;
+  // the nodes between the first and the last changed edge in their new order
+  thread_local std::vector<int> seq;
+  seq.clear();
+  auto segment = [&]()
+  {
+    for (int y = reversed ? e : s; ; y = reversed ? nodes_[y].prev : nodes_[y].next)
     {
-      fp.repositionFrom(i);
-      continue;
+      seq.push_back(y);
+      if (y == (reversed ? s : e))
+        break;
     }
-    double cost = fp.eraseAtCost(i) + tp.insertCost(c);
-    if (cost < 0)
+  };
+  if (nodes_[x].pos < nodes_[s].pos)
+  {
+    // x [s..e] ... p q
+    segment();
+    for (int y = nodes_[x].next; y != s; y = nodes_[y].next)
+      seq.push_back(y);
+    return timeOk_(x, seq.data(), (int)seq.size(), nodes_[e].next);
+  }
+  // p q ... x [s..e] y
+  for (int y = nodes_[e].next; ; y = nodes_[y].next)
+  {
+    seq.push_back(y);
+    if (y == x)
+      break;
+  }
+  segment();
+  return timeOk_(nodes_[s].prev, seq.data(), (int)seq.size(), nodes_[x].next);
+}
+
+bool Solution::pathTimeOk_(const std::vector<int> & path, int depot)
+{
+  if (!timeWindows)
+    return true;
+  double t = customers[depot].ready;
+  int a = depot;
+  for (int c : path)
+  {
+    t = std::max(customers[c].ready, t + customers[a].service + dist(a, c));
+    if (t > customers[c].due)
+      return false;
+    a = c;
+  }
+  return t + customers[a].service + dist(a, depot) <= customers[depot].due;
+}
+
+void Solution::flip_(int from, int to)
+{
+  for (int x = from; ; )
+  {
+    int next = nodes_[x].next;
+    std::swap(nodes_[x].next, nodes_[x].prev);
+    if (x == to)
+      break;
+    x = next;
+  }
+}
+
+double Solution::insertCost_(int c, int v, int & after, bool force) const
+{
+  after = -1;
+  int load = load_(v) + customers[c].demand;
+  if (!fits_(v, load) && !force)
+    return DBL_MAX;
+
+  double res = DBL_MAX;
+  double before = d_(first_(v), c);
+  for (int a = first_(v); a != last_(v); )
+  {
+    int b = nodes_[a].next;
+    double next = d_(c, b);
+    double x = before + next - (nodes_[b].len - nodes_[a].len);
+    if (x < res && (force || timeOk_(a, &c, 1, b)))
     {
-      fp.eraseAt(i);
-      tp.insert(c);
-      continue;
+      res = x;
+      after = a;
     }
+    before = next;
+    a = b;
   }
+  return after >= 0 ? res + overload_(v, load) - overload_(v, load_(v)) : res;
 }
 
-void Solution::swapCustomers(int tries)
+void Solution::listPositions_(Positions & p) const
 {
-  std::uniform_int_distribution<> path(0, V - 1);
-  for (int t = 0; t < tries; ++t)
+  size_t n = nodes_.size() - V;
+  p.x0.resize(n);
+  p.y0.resize(n);
+  p.x1.resize(n);
+  p.y1.resize(n);
+  p.len.resize(n);
+  p.after.resize(n);
+  p.begin.resize(V + 1);
+  size_t i = 0;
+  for (int v = 0; v < V; ++v)
   {
-    auto & p0 = vs_[path(re)];
-    auto & p1 = vs_[path(re)];
-    int stops0 = p0.stops();
-    int stops1 = p1.stops();
-    if (stops0 <= 0 || stops1 <= 0)
-      continue;
-    int i0 = std::uniform_int_distribution<>(0, stops0 - 1)(re);
-    int i1 = std::uniform_int_distribution<>(0, stops1 - 1)(re);
-    if (&p0 == &p1)
+    p.begin[v] = (int)i;
+    for (int a = first_(v); a != last_(v); a = nodes_[a].next, ++i)
     {
-      p0.repositionFrom(i0);
-      p0.repositionFrom(i1);
-      continue;
+      const Customer & c0 = customers[loc_(a)];
+      const Customer & c1 = customers[loc_(nodes_[a].next)];
+      p.x0[i] = (float)c0.x;
+      p.y0[i] = (float)c0.y;
+      p.x1[i] = (float)c1.x;
+      p.y1[i] = (float)c1.y;
+      p.len[i] = (float)edge_(a);
+      p.after[i] = a;
     }
-    double eraseCost0 = p0.eraseAtCost(i0);
-    double eraseCost1 = p1.eraseAtCost(i1);
-    if (eraseCost0 + eraseCost1 >= DBL_MAX)
-      continue;
-    int c0 = p0.customerAt(i0);
-    int c1 = p1.customerAt(i1);
-    p0.eraseAt(i0);
-    p1.eraseAt(i1);
-    double insertCost = p0.insertCost(c1) + p1.insertCost(c0);
-    if (eraseCost0 + eraseCost1 + insertCost < 0)
-    {
-      p0.insert(c1);
-      p1.insert(c0);
+  }
+  p.begin[V] = (int)i;
+}
+
+void Solution::insertCosts_(int c, const Positions & p, double * cost, int * after) const
+{
+  if (timeWindows)
+  {
+    for (int v = 0; v < V; ++v)
+      cost[v] = insertCost_(c, v, after[v]);
+    return;
+  }
+
+  int n = p.begin[V];
+  thread_local std::vector<float> delta;
+  delta.resize(n);
+  const float * x0 = p.x0.data(), * y0 = p.y0.data(), * x1 = p.x1.data(), * y1 = p.y1.data(), * len = p.len.data();
+  float * d = delta.data();
+  float cx = (float)customers[c].x, cy = (float)customers[c].y;
+  for (int i = 0; i < n; ++i)
+  {
+    float dx0 = x0[i] - cx, dy0 = y0[i] - cy, dx1 = x1[i] - cx, dy1 = y1[i] - cy;
+    d[i] = std::sqrt(dx0 * dx0 + dy0 * dy0) + std::sqrt(dx1 * dx1 + dy1 * dy1) - len[i];
+  }
+
+  for (int v = 0; v < V; ++v)
+  {
+    cost[v] = DBL_MAX;
+    after[v] = -1;
+    int load = load_(v) + customers[c].demand;
+    if (!fits_(v, load))
       continue;
-    }
-    p0.insert(c0);
-    insertCost = p0.insertCost(c1);
-    if (eraseCost1 + insertCost < 0)
+    int best = p.begin[v];
+    for (int i = best + 1; i < p.begin[v + 1]; ++i)
     {
-      p0.insert(c1);
-      continue;
+      if (d[i] < d[best])
+        best = i;
     }
-    p1.insert(c1);
+    cost[v] = d[best] + overload_(v, load) - overload_(v, load_(v));
+    after[v] = p.after[best];
   }
 }
 
-int main(int argc, char * argv[])
+void Solution::insertAfter_(int c, int after)
 {
-  if (argc != 2)
-    return 1;
-  readData(argv[1]);
+  int b = nodes_[after].next;
+  link_(after, c);
+  link_(c, b);
+  changed_[nodes_[after].route] = 1;
+  refresh_(nodes_[after].route);
+}
 
-  Solution best;
+void Solution::insertBest_(int c, int v, bool force)
+{
+  int after;
+  insertCost_(c, v, after, force);
+  if (after >= 0)
+    insertAfter_(c, after);
+}
 
-  std::ofstream log("vrp.log", std::ofstream::app);
-  log.precision(12);
-  for (int iter = 0; iter < 100; ++iter)
+double Solution::eraseCost_(int c) const
+{
+  int p = nodes_[c].prev, n = nodes_[c].next, v = route_(c);
+  return d_(p, n) - (nodes_[n].len - nodes_[p].len)
+    - (overload_(v, load_(v)) - overload_(v, load_(v) - customers[c].demand));
+}
+
+double Solution::moveCost_(int c, int v, int & after) const
+{
+  uint64_t key = MoveCache::key(0, c, 0, signature_[route_(c)], signature_[v], penalty_);
+  if (const MoveCache::Entry * e = moveCache.find(key))
   {
-    best.swapCustomers(10000);
-    log << "N=" << customers.size()
-      << "\titer=" << iter
-      << "\tbest=" << best.cost()
-      << std::endl;
+    after = e->after;
+    return e->cost;
+  }
+  double cost = eraseCost_(c) + insertCost_(c, v, after);
+  MoveCache::Entry & e = moveCache.store(key);
+  e.cost = cost;
+  e.after = after;
+  return cost;
+}
+
+void Solution::remove_(int c)
+{
+  int v = nodes_[c].route;
+  link_(nodes_[c].prev, nodes_[c].next);
+  nodes_[c] = Node();
+  changed_[v] = 1;
+  refresh_(v);
+}
+
+bool Solution::reposition_(int c)
+{
+  int v = nodes_[c].route;
+  // only improving positions are checked for the time windows; the load stays, so unlike eraseCost_
+  // the saving is the length only
+  int p = nodes_[c].prev, n = nodes_[c].next;
+  double minIncr = nodes_[n].len - nodes_[p].len - d_(p, n) - 1e-9;
+  int minAfter = -1;
+  for (int a = first_(v); a != last_(v); a = nodes_[a].next)
+  {
+    int b = nodes_[a].next;
+    if (a == c || b == c)
+      continue;
+    double x = d_(a, c) + d_(c, b) - edge_(a);
+    if (x < minIncr && moveTimeOk_(c, c, a, false))
+    {
+      minIncr = x;
+      minAfter = a;
+    }
+  }
+  if (minAfter < 0)
+    return false;
+  remove_(c);
+  insertAfter_(c, minAfter);
+  return true;
+}
+
+bool Solution::twoOpt_(int v)
+{
+  // whether the route keeps the time windows with the nodes after a up to b reversed
+  auto reversedTimeOk = [&](int a, int b)
+  {
+    if (!timeWindows)
+      return true;
+    thread_local std::vector<int> seq;
+    seq.clear();
+    for (int y = b; y != a; y = nodes_[y].prev)
+      seq.push_back(y);
+    return timeOk_(a, seq.data(), (int)seq.size(), nodes_[b].next);
+  };
+
+  bool res = false;
+  for (bool improved = true; improved; )
+  {
+    improved = false;
+    for (int a = first_(v); a != last_(v) && !improved; a = nodes_[a].next)
+    {
+      int a1 = nodes_[a].next;
+      if (a1 == last_(v))
+        break;
+      for (int b = nodes_[a1].next; b != last_(v); b = nodes_[b].next)
+      {
+        int b1 = nodes_[b].next;
+        double gain = edge_(a) + edge_(b) - d_(a, b) - d_(a1, b1);
+        if (gain <= 1e-9 || !reversedTimeOk(a, b))
+          continue;
+        flip_(a1, b);
+        link_(a, b);
+        link_(a1, b1);
+        refresh_(v);
+        improved = res = true;
+        break;
+      }
+    }
+  }
+  return res;
+}
+
+bool Solution::orOpt_(int v)
+{
+  bool res = false;
+  for (bool improved = true; improved; )
+  {
+    improved = false;
+    for (int len = 1; len <= 3 && !improved; ++len)
+    {
+      // segment s..e between p and q
+      for (int s = nodes_[first_(v)].next; s != last_(v) && !improved; s = nodes_[s].next)
+      {
+        int e = s;
+        for (int k = 1; k < len && e != last_(v); ++k)
+          e = nodes_[e].next;
+        if (e == last_(v))
+          break;
+        int p = nodes_[s].prev, q = nodes_[e].next;
+        double removeGain = edge_(p) + edge_(e) - d_(p, q);
+        if (removeGain <= 1e-9)
+          continue;
+        for (int x = first_(v); x != last_(v); x = nodes_[x].next)
+        {
+          if (nodes_[x].pos >= nodes_[p].pos && nodes_[x].pos <= nodes_[e].pos)
+            continue;
+          int y = nodes_[x].next;
+          double straight = d_(x, s) + d_(e, y) - edge_(x);
+          double reversed = d_(x, e) + d_(s, y) - edge_(x);
+          // the better orientation keeping the time windows
+          bool okStraight = removeGain - straight > 1e-9 && moveTimeOk_(s, e, x, false);
+          bool okReversed = removeGain - reversed > 1e-9 && moveTimeOk_(s, e, x, true);
+          if (!okStraight && !okReversed)
+            continue;
+          link_(p, q);
+          if (okReversed && (!okStraight || reversed < straight))
+          {
+            flip_(s, e);
+            std::swap(s, e);
+          }
+          link_(x, s);
+          link_(e, y);
+          refresh_(v);
+          improved = res = true;
+          break;
+        }
+      }
+    }
+  }
+  return res;
+}
+
+bool Solution::twoOptStar_(int v, int w)
+{
+  // with different depots a tail ends at the other depot, its late times do not hold there
+  int depotV = vehicles[v].depot, depotW = vehicles[w].depot;
+  auto tailTimeOk = [&](int a, int from, int to)
+  {
+    if (!timeWindows)
+      return true;
+    thread_local std::vector<int> tail;
+    tail.clear();
+    // up to the end depot, the only node without a next one
+    for (int x = from; nodes_[x].next >= 0; x = nodes_[x].next)
+      tail.push_back(x);
+    return timeOk_(a, tail.data(), (int)tail.size(), to);
+  };
+
+  bool res = false;
+  for (bool improved = true; improved; )
+  {
+    improved = false;
+    int loadV = load_(v), loadW = load_(w);
+    // the last customers
+    int la = nodes_[last_(v)].prev, lb = nodes_[last_(w)].prev;
+    // v: ... a] + [b1 ..., w: ... b] + [a1 ...
+    for (int a = first_(v); a != last_(v) && !improved; a = nodes_[a].next)
+    {
+      for (int b = first_(w); b != last_(w); b = nodes_[b].next)
+      {
+        int newV = nodes_[a].load + loadW - nodes_[b].load, newW = nodes_[b].load + loadV - nodes_[a].load;
+        if (!fits_(v, newV) || !fits_(w, newW))
+          continue;
+        double excessGain = penalty_ > 0
+          ? overload_(v, loadV) + overload_(w, loadW) - overload_(v, newV) - overload_(w, newW) : 0;
+        int a1 = nodes_[a].next, b1 = nodes_[b].next;
+        bool tailA = a1 != last_(v), tailB = b1 != last_(w);
+        if (depotV == depotW)
+        {
+          double gain = edge_(a) + edge_(b) - d_(a, b1) - d_(b, a1) + excessGain;
+          // the late times of the tails hold in the other route as well
+          if (gain <= 1e-9 || !timeOk_(a, nullptr, 0, b1) || !timeOk_(b, nullptr, 0, a1))
+            continue;
+        }
+        else
+        {
+          double before = edge_(a) + edge_(b) + (tailA ? dist(loc_(la), depotV) : 0)
+            + (tailB ? dist(loc_(lb), depotW) : 0);
+          double after = (tailB ? d_(a, b1) + dist(loc_(lb), depotV) : dist(loc_(a), depotV))
+            + (tailA ? d_(b, a1) + dist(loc_(la), depotW) : dist(loc_(b), depotW));
+          if (before - after + excessGain <= 1e-9 || !tailTimeOk(a, b1, last_(v)) || !tailTimeOk(b, a1, last_(w)))
+            continue;
+        }
+        // the end depots stay with their routes
+        if (tailB)
+        {
+          link_(a, b1);
+          link_(lb, last_(v));
+        }
+        else
+          link_(a, last_(v));
+        if (tailA)
+        {
+          link_(b, a1);
+          link_(la, last_(w));
+        }
+        else
+          link_(b, last_(w));
+        changed_[v] = changed_[w] = 1;
+        refresh_(v);
+        refresh_(w);
+        improved = res = true;
+        break;
+      }
+    }
+  }
+  return res;
+}
+
+bool Solution::crossExchange_(int v, int w)
+{
+  // the pairs of segments are scanned by position in the routes, the nodes of both routes with their
+  // locations and prefix sums are listed once per pass as following the links in the inner loop is slower
+  struct Stop
+  {
+    int node, loc, load;
+    double len;
+  };
+  thread_local std::vector<Stop> pv, pw;
+  auto list = [&](int r, std::vector<Stop> & p)
+  {
+    p.clear();
+    for (int x = first_(r); x >= 0; x = nodes_[x].next)
+      p.push_back({x, loc_(x), nodes_[x].load, nodes_[x].len});
+  };
+
+  bool res = false;
+  for (bool improved = true; improved; )
+  {
+    improved = false;
+    list(v, pv);
+    list(w, pw);
+    int nv = (int)pv.size(), nw = (int)pw.size();
+    int loadV = load_(v), loadW = load_(w);
+    for (int la = 0; la <= 3 && !improved; ++la)
+    {
+      for (int lb = la == 0 ? 1 : 0; lb <= 3 && !improved; ++lb)
+      {
+        // segments sa..ea after a and sb..eb after b, followed by na and nb
+        for (int i = 0; i + la + 1 < nv && !improved; ++i)
+        {
+          const Stop & a = pv[i], & sa = pv[i + 1], & ea = pv[i + la], & na = pv[i + la + 1];
+          int segA = ea.load - a.load;
+          double oldA = na.len - a.len;
+          double innerA = la > 0 ? ea.len - sa.len : 0;
+          for (int j = 0; j + lb + 1 < nw; ++j)
+          {
+            const Stop & b = pw[j], & sb = pw[j + 1], & eb = pw[j + lb], & nb = pw[j + lb + 1];
+            int segB = eb.load - b.load;
+            int newV = loadV - segA + segB, newW = loadW - segB + segA;
+            if (!fits_(v, newV) || !fits_(w, newW))
+              continue;
+            double excessGain = penalty_ > 0
+              ? overload_(v, loadV) + overload_(w, loadW) - overload_(v, newV) - overload_(w, newW) : 0;
+            double oldB = nb.len - b.len;
+            double innerB = lb > 0 ? eb.len - sb.len : 0;
+            double newA = lb > 0 ? dist(a.loc, sb.loc) + innerB + dist(eb.loc, na.loc) : dist(a.loc, na.loc);
+            double newB = la > 0 ? dist(b.loc, sa.loc) + innerA + dist(ea.loc, nb.loc) : dist(b.loc, nb.loc);
+            if (oldA + oldB - newA - newB + excessGain <= 1e-9)
+              continue;
+            if (timeWindows)
+            {
+              int segV[3], segW[3];
+              for (int k = 0; k < la; ++k)
+                segV[k] = pv[i + 1 + k].node;
+              for (int k = 0; k < lb; ++k)
+                segW[k] = pw[j + 1 + k].node;
+              if (!timeOk_(a.node, segW, lb, na.node) || !timeOk_(b.node, segV, la, nb.node))
+                continue;
+            }
+            if (lb > 0)
+            {
+              link_(a.node, sb.node);
+              link_(eb.node, na.node);
+            }
+            else
+              link_(a.node, na.node);
+            if (la > 0)
+            {
+              link_(b.node, sa.node);
+              link_(ea.node, nb.node);
+            }
+            else
+              link_(b.node, nb.node);
+            changed_[v] = changed_[w] = 1;
+            refresh_(v);
+            refresh_(w);
+            improved = res = true;
+            break;
+          }
+        }
+      }
+    }
+  }
+  return res;
+}
+
+bool Solution::buildByDemand_()
+{
+  std::vector<std::pair<int, int>> demandCust;
+  for (int c = D; c < (int)customers.size(); ++c)
+    demandCust.emplace_back(customers[c].demand, c);
+  std::sort(demandCust.rbegin(), demandCust.rend());
+
+  std::vector<int> order, removed;
+  for (const auto & dc : demandCust)
+    order.push_back(dc.second);
+  buildInOrder_(order, removed);
+  return removed.empty();
+}
+
+void Solution::buildInOrder_(const std::vector<int> & order, std::vector<int> & removed)
+{
+  std::vector<double> cost(V);
+  std::vector<int> after(V);
+  Positions positions;
+  for (int c : order)
+  {
+    listPositions_(positions);
+    insertCosts_(c, positions, cost.data(), after.data());
+    double minCost = DBL_MAX;
+    int bestAfter = -1;
+    for (int v = 0; v < V; ++v)
+    {
+      if (after[v] >= 0 && cost[v] < minCost)
+      {
+        minCost = cost[v];
+        bestAfter = after[v];
+      }
+    }
+    if (bestAfter >= 0)
+      insertAfter_(c, bestAfter);
+    else
+      removed.push_back(c);
+  }
+}
+
+bool Solution::buildSavings_()
+{
+  for (int v = 0; v < V; ++v)
+  {
+    if (D > 1 || cap_(v) != C)
+      return false;
+  }
+  int n = (int)customers.size();
+  std::vector<std::vector<int>> routes(n);
+  std::vector<int> load(n, 0);
+  std::vector<int> route(n, -1);
+  for (int c = 1; c < n; ++c)
+  {
+    routes[c].push_back(c);
+    load[c] = customers[c].demand;
+    route[c] = c;
+  }
+
+  std::vector<std::pair<double, std::pair<int, int>>> savings;
+  for (int a = 1; a < n; ++a)
+  {
+    for (int q = 0; q < K; ++q)
+    {
+      int b = neighbors[(size_t)a * K + q];
+      if (a < b)
+        savings.emplace_back(dist(0, a) + dist(0, b) - dist(a, b), std::make_pair(a, b));
+    }
+  }
+  std::sort(savings.rbegin(), savings.rend());
+
+  for (const auto & s : savings)
+  {
+    int a = s.second.first, b = s.second.second;
+    int ra = route[a], rb = route[b];
+    if (s.first <= 0 || ra == rb || load[ra] + load[rb] > C)
+      continue;
+    auto & pa = routes[ra];
+    auto & pb = routes[rb];
+    if ((pa.front() != a && pa.back() != a) || (pb.front() != b && pb.back() != b))
+      continue;
+    // ... a] + [b ...
+    if (timeWindows)
+    {
+      std::vector<int> merged(pa.begin(), pa.end());
+      if (pa.back() != a)
+        std::reverse(merged.begin(), merged.end());
+      if (pb.front() == b)
+        merged.insert(merged.end(), pb.begin(), pb.end());
+      else
+        merged.insert(merged.end(), pb.rbegin(), pb.rend());
+      if (!pathTimeOk_(merged, 0))
+        continue;
+    }
+    if (pa.back() != a)
+      std::reverse(pa.begin(), pa.end());
+    if (pb.front() != b)
+      std::reverse(pb.begin(), pb.end());
+    for (int c : pb)
+      route[c] = ra;
+    pa.insert(pa.end(), pb.begin(), pb.end());
+    load[ra] += load[rb];
+    load[rb] = 0;
+    pb.clear();
+  }
+
+  std::vector<int> order;
+  for (int r = 1; r < n; ++r)
+  {
+    if (!routes[r].empty())
+      order.push_back(r);
+  }
+  std::sort(order.begin(), order.end(), [&](int x, int y) { return routes[x].size() > routes[y].size(); });
+  std::vector<int> removed;
+  for (int i = 0; i < (int)order.size(); ++i)
+  {
+    const auto & r = routes[order[i]];
+    if (i >= V)
+    {
+      removed.insert(removed.end(), r.begin(), r.end());
+      continue;
+    }
+    int a = first_(i);
+    for (int c : r)
+    {
+      link_(a, c);
+      a = c;
+    }
+    link_(a, last_(i));
+    refresh_(i);
+  }
+  return recreate(removed, 3);
+}
+
+double Solution::cost() const
+{
+  assert(fabs(cost_ - length_()) <= 1e-6 * (1 + cost_));
+  return cost_;
+}
+
+double Solution::length_() const
+{
+  double res = 0;
+  for (int v = 0; v < V; ++v)
+  {
+    for (int a = first_(v); a != last_(v); a = nodes_[a].next)
+      res += d_(a, nodes_[a].next);
+  }
+  return res;
+}
+
+void Solution::setPenalty(double weight)
+{
+  penalty_ = weight;
+  // the routes the local search left may have improving moves with the new weight
+  std::fill(clean_.begin(), clean_.end(), 0);
+}
+
+bool Solution::repair()
+{
+  // the moves push the excess out under a growing weight, the customers of the routes still over the
+  // capacity are reinserted
+  double weight = penalty_;
+  for (int k = 0; k < 2 && excess_ > 0; ++k)
+  {
+    weight *= 10;
+    setPenalty(weight);
+    relocateCustomers();
+    localSearch();
+  }
+  setPenalty(0);
+  std::vector<int> removed;
+  for (int v = 0; v < V; ++v)
+  {
+    while (load_(v) > cap_(v))
+    {
+      int worst = -1;
+      double minCost = DBL_MAX;
+      for (int a = nodes_[first_(v)].next; a != last_(v); a = nodes_[a].next)
+      {
+        double cost = eraseCost_(a);
+        if (cost < minCost)
+        {
+          minCost = cost;
+          worst = a;
+        }
+      }
+      remove_(worst);
+      removed.push_back(worst);
+    }
+  }
+  if (recreate(removed, 3))
+    return true;
+  insertForced_(removed, nullptr);
+  return false;
+}
+
+bool Solution::feasible() const
+{
+  for (int v = 0; v < V; ++v)
+  {
+    if (load_(v) > cap_(v))
+      return false;
+    for (int a = first_(v); timeWindows && a >= 0; a = nodes_[a].next)
+    {
+      if (nodes_[a].early > customers[loc_(a)].due)
+        return false;
+    }
+  }
+  return true;
+}
+
+std::vector<int> Solution::giantTour() const
+{
+  std::vector<int> tour;
+  for (int v = 0; v < V; ++v)
+  {
+    for (int a = nodes_[first_(v)].next; a != last_(v); a = nodes_[a].next)
+      tour.push_back(a);
+  }
+  return tour;
+}
+
+double Solution::brokenPairs(const Solution & other) const
+{
+  int broken = 0;
+  for (int c = D; c < n_; ++c)
+  {
+    int next = loc_(nodes_[c].next);
+    if (next != other.loc_(other.nodes_[c].next) && next != other.loc_(other.nodes_[c].prev))
+      ++broken;
+  }
+  return (double)broken / std::max(1, n_ - D);
+}
+
+void Solution::print(std::ostream & os) const
+{
+  os.precision(12);
+  os << cost() << " 0\n";
+
+  for (int v = 0; v < V; ++v)
+  {
+    for (int a = first_(v); ; a = nodes_[a].next)
+    {
+      os << loc_(a) << ' ';
+      if (a == last_(v))
+        break;
+    }
+    os << '\n';
+  }
+  os << std::endl;
+}
+
+void Solution::printRoutes(std::ostream & os) const
+{
+  for (int v = 0; v < V; ++v)
+  {
+    os << " |";
+    for (int a = first_(v); ; a = nodes_[a].next)
+    {
+      os << ' ' << loc_(a);
+      if (a == last_(v))
+        break;
+    }
+  }
+}
+
+void Solution::optimizeRoutes(ThreadPool * pool)
+{
+  // orders of the changed routes are optimized in copies, so the threads share nothing
+  std::vector<int> todo;
+  std::vector<std::vector<int>> paths;
+  for (int v = 0; v < V; ++v)
+  {
+    if (changed_[v] && stops_(v) > 2)
+    {
+      todo.push_back(v);
+      paths.emplace_back();
+      for (int a = nodes_[first_(v)].next; a != last_(v); a = nodes_[a].next)
+        paths.back().push_back(a);
+    }
+    changed_[v] = 0;
+  }
+
+  // a single route or worker is solved on the calling thread
+  int n = (int)paths.size();
+  if (pool && pool->size() > 1 && n > 1)
+    pool->parallelFor(n, [&](int i, int) { optimizeOrder_(paths[i], vehicles[todo[i]].depot); });
+  else
+  {
+    for (int i = 0; i < n; ++i)
+      optimizeOrder_(paths[i], vehicles[todo[i]].depot);
+  }
+
+  for (size_t i = 0; i < paths.size(); ++i)
+  {
+    int v = todo[i];
+    int depot = vehicles[v].depot;
+    double len = 0;
+    int a = depot;
+    for (int c : paths[i])
+    {
+      len += dist(a, c);
+      a = c;
+    }
+    len += dist(a, depot);
+    if (len >= nodes_[last_(v)].len - 1e-9)
+      continue;
+    a = first_(v);
+    for (int c : paths[i])
+    {
+      link_(a, c);
+      a = c;
+    }
+    link_(a, last_(v));
+    refresh_(v);
+  }
+}
+
+void Solution::optimizeOrder_(std::vector<int> & path, int depot)
+{
+  int m = (int)path.size();
+  if (m <= MAX_EXACT && !timeWindows)
+  {
+    // Held-Karp: length[set][j] - the shortest path from the depot over the set ending at path[j]
+    thread_local std::vector<double> length;
+    thread_local std::vector<signed char> last;
+    length.assign((size_t)m << m, DBL_MAX);
+    last.assign((size_t)m << m, -1);
+    for (int j = 0; j < m; ++j)
+      length[((size_t)1 << j) * m + j] = dist(depot, path[j]);
+    for (int set = 1; set < (1 << m); ++set)
+    {
+      for (int j = 0; j < m; ++j)
+      {
+        double x = length[(size_t)set * m + j];
+        if (x == DBL_MAX)
+          continue;
+        for (int k = 0; k < m; ++k)
+        {
+          if (set & (1 << k))
+            continue;
+          double y = x + dist(path[j], path[k]);
+          size_t to = (size_t)(set | (1 << k)) * m + k;
+          if (y < length[to])
+          {
+            length[to] = y;
+            last[to] = (signed char)j;
+          }
+        }
+      }
+    }
+    int set = (1 << m) - 1;
+    int j = 0;
+    for (int k = 1; k < m; ++k)
+    {
+      if (length[(size_t)set * m + k] + dist(path[k], depot) < length[(size_t)set * m + j] + dist(path[j], depot))
+        j = k;
+    }
+    std::vector<int> order;
+    while (j >= 0)
+    {
+      order.push_back(path[j]);
+      int prev = last[(size_t)set * m + j];
+      set &= ~(1 << j);
+      j = prev;
+    }
+    path.assign(order.rbegin(), order.rend());
+    return;
+  }
+
+  // the depot at both ends; a customer whose edges did not change since no move was found from it
+  // is not tried again
+  std::vector<int> p(1, depot);
+  p.insert(p.end(), path.begin(), path.end());
+  p.push_back(depot);
+  int n = (int)p.size();
+  thread_local std::vector<char> active;
+  active.resize(customers.size());
+  for (int c : p)
+    active[c] = 1;
+  std::vector<int> candidate;
+  auto timeOk = [&]()
+  {
+    return pathTimeOk_(std::vector<int>(candidate.begin() + 1, candidate.end() - 1), depot);
+  };
+  for (bool improved = true; improved; )
+  {
+    improved = false;
+    for (int i = 0; i + 1 < n; ++i)
+    {
+      if (!active[p[i]])
+        continue;
+      bool found = false;
+      // 2-opt of the edge (i, i + 1) with another edge
+      for (int j = 0; j + 1 < n && !found; ++j)
+      {
+        if (j + 1 >= i && j <= i + 1)
+          continue;
+        double gain = dist(p[i], p[i + 1]) + dist(p[j], p[j + 1]) - dist(p[i], p[j]) - dist(p[i + 1], p[j + 1]);
+        if (gain <= 1e-9)
+          continue;
+        int lo = std::min(i, j) + 1, hi = std::max(i, j);
+        if (timeWindows)
+        {
+          candidate = p;
+          std::reverse(candidate.begin() + lo, candidate.begin() + hi + 1);
+          if (!timeOk())
+            continue;
+        }
+        std::reverse(p.begin() + lo, p.begin() + hi + 1);
+        active[p[lo - 1]] = active[p[lo]] = active[p[hi]] = active[p[hi + 1]] = 1;
+        found = true;
+      }
+      // Or-opt of the segment of 1-3 customers starting at i + 1 to another edge (k, k + 1), possibly
+      // reversed
+      for (int len = 1; len <= 3 && !found; ++len)
+      {
+        int s = i + 1, e = i + len;
+        if (e + 1 >= n)
+          break;
+        double removeGain = dist(p[i], p[s]) + dist(p[e], p[e + 1]) - dist(p[i], p[e + 1]);
+        for (int k = 0; k + 1 < n && !found; ++k)
+        {
+          if (k >= i && k <= e)
+            continue;
+          double straight = dist(p[k], p[s]) + dist(p[e], p[k + 1]) - dist(p[k], p[k + 1]);
+          double reversed = dist(p[k], p[e]) + dist(p[s], p[k + 1]) - dist(p[k], p[k + 1]);
+          bool reverse = reversed < straight;
+          if (removeGain - std::min(straight, reversed) <= 1e-9)
+            continue;
+          candidate = p;
+          if (reverse)
+            std::reverse(candidate.begin() + s, candidate.begin() + e + 1);
+          if (k < i)
+            std::rotate(candidate.begin() + k + 1, candidate.begin() + s, candidate.begin() + e + 1);
+          else
+            std::rotate(candidate.begin() + s, candidate.begin() + e + 1, candidate.begin() + k + 1);
+          if (timeWindows && !timeOk())
+            continue;
+          // the ends of the removed and the new edges
+          active[p[i]] = active[p[s]] = active[p[e]] = active[p[e + 1]] = active[p[k]] = active[p[k + 1]] = 1;
+          p.swap(candidate);
+          found = true;
+        }
+      }
+      if (found)
+        improved = true;
+      else
+        active[p[i]] = 0;
+    }
+  }
+  path.assign(p.begin() + 1, p.end() - 1);
+}
+
+void Solution::localSearch()
+{
+  // a route or a pair of routes is tried again only if some of them changed since it was last tried
+  // without a change, here or in the previous local search
+  thread_local std::vector<unsigned> routeTried, pairTried;
+  routeTried = clean_;
+  pairTried.resize((size_t)V * V * 2);
+  for (int a = 0; a < V; ++a)
+  {
+    for (int b = a + 1; b < V; ++b)
+    {
+      pairTried[((size_t)a * V + b) * 2] = clean_[a];
+      pairTried[((size_t)a * V + b) * 2 + 1] = clean_[b];
+    }
+  }
+  std::vector<char> near;
+  for (bool improved = true; improved; )
+  {
+    improved = false;
+    for (int v = 0; v < V; ++v)
+    {
+      if (routeTried[v] == version_[v])
+        continue;
+      if (twoOpt_(v))
+        improved = true;
+      if (orOpt_(v))
+        improved = true;
+      routeTried[v] = version_[v];
+    }
+    // routes are tried only if some of their customers are neighbours, it saves most of the pairs and
+    // the ones left give nearly all improvements
+    {
+      near.assign((size_t)V * V, 0);
+      for (int c = D; c < (int)customers.size(); ++c)
+      {
+        for (int q = 0; q < K; ++q)
+        {
+          int v = route_(c), w = route_(neighbors[(size_t)c * K + q]);
+          if (v >= 0 && w >= 0)
+            near[(size_t)v * V + w] = near[(size_t)w * V + v] = 1;
+        }
+      }
+    }
+    for (int a = 0; a < V; ++a)
+    {
+      for (int b = a + 1; b < V; ++b)
+      {
+        if (!near[(size_t)a * V + b])
+          continue;
+        unsigned * tried = &pairTried[((size_t)a * V + b) * 2];
+        if (tried[0] == version_[a] && tried[1] == version_[b])
+          continue;
+        unsigned va = version_[a], vb = version_[b];
+        if (twoOptStar_(a, b))
+          improved = true;
+        if (crossExchange_(a, b))
+          improved = true;
+        if (va == version_[a] && vb == version_[b])
+        {
+          tried[0] = va;
+          tried[1] = vb;
+        }
+      }
+    }
+  }
+  clean_ = version_;
+}
+
+void Solution::ruinRandom(int count, std::vector<int> & removed)
+{
+  std::vector<int> assigned;
+  for (int c = D; c < (int)customers.size(); ++c)
+  {
+    if (route_(c) >= 0)
+      assigned.push_back(c);
+  }
+  std::shuffle(assigned.begin(), assigned.end(), re);
+  for (int i = 0; i < count && i < (int)assigned.size(); ++i)
+  {
+    remove_(assigned[i]);
+    removed.push_back(assigned[i]);
+  }
+}
+
+void Solution::ruinWorst(int count, std::vector<int> & removed)
+{
+  // the customers are sorted by decreasing saving once, each removed one is taken at random position
+  // biased towards the beginning
+  const double BIAS = 3;
+  std::uniform_real_distribution<> y(0, 1);
+  std::vector<std::pair<double, int>> savings;
+  for (int c = D; c < (int)customers.size(); ++c)
+  {
+    if (route_(c) >= 0)
+      savings.emplace_back(eraseCost_(c), c);
+  }
+  std::sort(savings.begin(), savings.end());
+  for (int k = 0; k < count && !savings.empty(); ++k)
+  {
+    size_t i = (size_t)(pow(y(re), BIAS) * savings.size());
+    int c = savings[i].second;
+    savings.erase(savings.begin() + i);
+    remove_(c);
+    removed.push_back(c);
+  }
+}
+
+void Solution::ruinRelated(int count, std::vector<int> & removed)
+{
+  std::uniform_int_distribution<> cust(D, (int)customers.size() - 1);
+  int c = cust(re);
+  std::vector<int> chosen;
+  for (int k = 0; k < count; ++k)
+  {
+    if (route_(c) < 0)
+    {
+      // a random assigned customer, if any
+      int tries = 0;
+      while (route_(c) < 0 && tries++ < 100)
+        c = cust(re);
+      if (route_(c) < 0)
+        break;
+    }
+    remove_(c);
+    removed.push_back(c);
+    chosen.push_back(c);
+    // the next is a not removed near customer of a removed one
+    int from = chosen[std::uniform_int_distribution<>(0, (int)chosen.size() - 1)(re)];
+    for (int q = 0; q < K; ++q)
+    {
+      c = neighbors[(size_t)from * K + q];
+      if (route_(c) >= 0)
+        break;
+    }
+  }
+}
+
+bool Solution::recreate(std::vector<int> & removed, int k, ThreadPool * pool)
+{
+  int r = (int)removed.size();
+  // insertion costs of removed[i] into route v and the nodes to insert after at [i*V + v]
+  std::vector<double> cost((size_t)r * V);
+  std::vector<int> after((size_t)r * V);
+  auto update = [&](int i, int v) { cost[(size_t)i * V + v] = insertCost_(removed[i], v, after[(size_t)i * V + v]); };
+  // the table is the bulk of the work, it is filled by parts of the customers in parallel
+  Positions positions;
+  listPositions_(positions);
+  auto fill = [&](int from, int to)
+  {
+    for (int i = from; i < to; ++i)
+      insertCosts_(removed[i], positions, &cost[(size_t)i * V], &after[(size_t)i * V]);
+  };
+  if (pool && pool->size() > 1 && (size_t)r * V >= 4096)
+  {
+    int parts = pool->size();
+    pool->parallelFor(parts, [&](int t, int)
+    {
+      fill((int)((long long)r * t / parts), (int)((long long)r * (t + 1) / parts));
+    });
+  }
+  else
+    fill(0, r);
+
+  // summary of each row: the cheapest cost and route, the k-th cheapest cost and the regret;
+  // missing alternatives count with a big cost, so customers with few feasible routes go first
+  const double MISSING = 1e12;
+  std::vector<double> top(k);
+  std::vector<double> rowMin(r), rowKth(r), rowRegret(r);
+  std::vector<int> rowV(r);
+  auto summarize = [&](int i)
+  {
+    std::fill(top.begin(), top.end(), MISSING);
+    rowV[i] = -1;
+    for (int v = 0; v < V; ++v)
+    {
+      double x = cost[(size_t)i * V + v];
+      if (after[(size_t)i * V + v] < 0 || x >= top[k - 1])
+        continue;
+      if (x < top[0])
+        rowV[i] = v;
+      int h = k - 1;
+      for (; h > 0 && top[h - 1] > x; --h)
+        top[h] = top[h - 1];
+      top[h] = x;
+    }
+    rowMin[i] = top[0];
+    rowKth[i] = top[k - 1];
+    rowRegret[i] = 0;
+    for (int h = 1; h < k; ++h)
+      rowRegret[i] += top[h] - top[0];
+  };
+  for (int i = 0; i < r; ++i)
+    summarize(i);
+
+  while (r > 0)
+  {
+    int bestI = -1;
+    for (int i = 0; i < r; ++i)
+    {
+      if (rowV[i] < 0)
+        return false;
+      if (bestI < 0 || rowRegret[i] > rowRegret[bestI]
+        || (rowRegret[i] == rowRegret[bestI] && rowMin[i] < rowMin[bestI]))
+        bestI = i;
+    }
+    int bestV = rowV[bestI];
+    insertAfter_(removed[bestI], after[(size_t)bestI * V + bestV]);
+    // the last one takes the place of the inserted
+    --r;
+    removed[bestI] = removed[r];
+    removed.pop_back();
+    std::copy(cost.begin() + (size_t)r * V, cost.begin() + (size_t)(r + 1) * V, cost.begin() + (size_t)bestI * V);
+    std::copy(after.begin() + (size_t)r * V, after.begin() + (size_t)(r + 1) * V, after.begin() + (size_t)bestI * V);
+    rowMin[bestI] = rowMin[r];
+    rowKth[bestI] = rowKth[r];
+    rowRegret[bestI] = rowRegret[r];
+    rowV[bestI] = rowV[r];
+    // only the changed route is evaluated again, a row summary is recomputed if the route was or
+    // becomes one of its k cheapest
+    for (int i = 0; i < r; ++i)
+    {
+      double old = after[(size_t)i * V + bestV] < 0 ? MISSING : cost[(size_t)i * V + bestV];
+      update(i, bestV);
+      double now = after[(size_t)i * V + bestV] < 0 ? MISSING : cost[(size_t)i * V + bestV];
+      if (old <= rowKth[i] || now < rowKth[i])
+        summarize(i);
+    }
+  }
+  return true;
+}
+
+// moves of customers are granular: the target is the route of one of K nearest customers
+void Solution::moveCustomers(int tries, Acceptance & acceptance)
+{
+  if (K == 0)
+    return;
+  std::uniform_int_distribution<> cust(D, (int)customers.size() - 1);
+  std::uniform_int_distribution<> near(0, K - 1);
+  for (int t = 0; t < tries; ++t)
+  {
+    int c = cust(re);
+    int fromPath = route_(c);
+    int toPath = route_(neighbors[(size_t)c * K + near(re)]);
+    if (fromPath < 0 || toPath < 0)
+      continue;
+    if (fromPath == toPath)
+    {
+      reposition_(c);
+      continue;
+    }
+    int after;
+    double cost = moveCost_(c, toPath, after);
+    if (after >= 0 && acceptance.accept(cost))
+    {
+      remove_(c);
+      insertAfter_(c, after);
+      continue;
+    }
+  }
+  moveCache.flush();
+}
+
+void Solution::relocateCustomers()
+{
+  std::vector<int> order;
+  for (int c = D; c < n_; ++c)
+    order.push_back(c);
+  std::shuffle(order.begin(), order.end(), re);
+  for (bool improved = true; improved; )
+  {
+    improved = false;
+    for (int c : order)
+    {
+      int from = route_(c);
+      if (from < 0)
+        continue;
+      reposition_(c);
+      double minCost = -1e-9;
+      int minAfter = -1;
+      for (int q = 0; q < K; ++q)
+      {
+        int v = route_(neighbors[(size_t)c * K + q]);
+        if (v < 0 || v == from)
+          continue;
+        // several neighbours share a route, and most routes stay the same between the sweeps
+        int after;
+        double cost = moveCost_(c, v, after);
+        if (after >= 0 && cost < minCost)
+        {
+          minCost = cost;
+          minAfter = after;
+        }
+      }
+      if (minAfter >= 0)
+      {
+        remove_(c);
+        insertAfter_(c, minAfter);
+        improved = true;
+      }
+    }
+  }
+  moveCache.flush();
+}
+
+// swaps a customer with a customer of the route of one of its K nearest customers
+void Solution::swapCustomers(int tries, Acceptance & acceptance)
+{
+  if (K == 0)
+    return;
+  std::uniform_int_distribution<> cust(D, (int)customers.size() - 1);
+  std::uniform_int_distribution<> near(0, K - 1);
+  for (int t = 0; t < tries; ++t)
+  {
+    int c0 = cust(re);
+    int v0 = route_(c0);
+    int v1 = route_(neighbors[(size_t)c0 * K + near(re)]);
+    if (v0 < 0 || v1 < 0)
+      continue;
+    int c1 = first_(v1);
+    for (int i = std::uniform_int_distribution<>(1, stops_(v1))(re); i > 0; --i)
+      c1 = nodes_[c1].next;
+    if (v0 == v1)
+    {
+      reposition_(c0);
+      reposition_(c1);
+      continue;
+    }
+    // a swap rejected before on the same routes is decided by its cached costs, it is cached only if
+    // the routes came back as they were
+    uint64_t key = MoveCache::key(1, c0, c1, signature_[v0], signature_[v1], penalty_);
+    if (const MoveCache::Entry * e = moveCache.find(key))
+    {
+      if (e->after >= 0 && e->after1 >= 0 && acceptance.accept(e->cost))
+      {
+        remove_(c0);
+        remove_(c1);
+        insertAfter_(c1, e->after);
+        insertAfter_(c0, e->after1);
+      }
+      else if (e->after2 >= 0 && acceptance.accept(e->cost2))
+      {
+        remove_(c1);
+        insertAfter_(c1, e->after2);
+      }
+      continue;
+    }
+    uint64_t signature0 = signature_[v0], signature1 = signature_[v1];
+    double eraseCost0 = eraseCost_(c0);
+    double eraseCost1 = eraseCost_(c1);
+    int prev0 = nodes_[c0].prev, prev1 = nodes_[c1].prev;
+    remove_(c0);
+    remove_(c1);
+    int after0, after1;
+    double insertCost = insertCost_(c1, v0, after0) + insertCost_(c0, v1, after1);
+    double swapCost = eraseCost0 + eraseCost1 + insertCost;
+    if (after0 >= 0 && after1 >= 0 && acceptance.accept(swapCost))
+    {
+      insertAfter_(c1, after0);
+      insertAfter_(c0, after1);
+      continue;
+    }
+    int swapAfter0 = after0, swapAfter1 = after1;
+    // the customers go back to their best positions, or where they were if the routes were over the
+    // capacity or late before
+    auto restore = [&](int c, int v, int prev)
+    {
+      int after;
+      insertCost_(c, v, after);
+      insertAfter_(c, after >= 0 ? after : prev);
+    };
+    restore(c0, v0, prev0);
+    insertCost = insertCost_(c1, v0, after0);
+    if (after0 >= 0 && acceptance.accept(eraseCost1 + insertCost))
+    {
+      insertAfter_(c1, after0);
+      continue;
+    }
+    restore(c1, v1, prev1);
+    if (signature_[v0] == signature0 && signature_[v1] == signature1)
+    {
+      MoveCache::Entry & e = moveCache.store(key);
+      e.cost = swapCost;
+      e.after = swapAfter0;
+      e.after1 = swapAfter1;
+      e.cost2 = eraseCost1 + insertCost;
+      e.after2 = after0;
+    }
+  }
+  moveCache.flush();
+}
+
+// best solution shared by the search threads
+struct Incumbent
+{
+  explicit Incumbent(const Solution & s) : solution(s), cost(s.cost()) {}
+  // takes given solution if it is better, the caller holds the mutex
+  bool offer(const Solution & s, double c)
+  {
+    if (c >= cost)
+      return false;
+    solution = s;
+    cost = c;
+    if (improved)
+      improved(solution, cost);
+    return true;
+  }
+  std::mutex mutex;
+  Solution solution;
+  double cost = DBL_MAX;
+  std::function<void(const Solution &, double)> improved; // called under the mutex
+};
+
+// adaptive large neighbourhood search: in each iteration some customers are removed by one of the ruin
+// operators and inserted back by one of the recreate operators, the operators are chosen by roulette
+// with weights adapting to their recent success
+class Alns
+{
+public:
+  Alns(const Solution & start, const std::string & accept);
+  // runs until the deadline or given number of iterations (0 - unlimited), the incumbent is exchanged
+  // every EXCHANGE iterations and gets each new best solution
+  void run(std::chrono::steady_clock::time_point startTime, double timeLimit, long long iterations,
+    Incumbent & incumbent);
+private:
+  static const int RUINS = 3;
+  static const int RECREATES = 3; // greedy, regret-2, regret-3
+  static const int SEGMENT = 100; // iterations between weight updates
+  static const int EXCHANGE = 200;
+
+  int choose_(const double * weights, int n);
+  void adapt_();
+
+  Solution current_;
+  Solution best_;
+  double currentCost_ = 0;
+  double bestCost_ = 0;
+  std::unique_ptr<Acceptance> acceptance_;
+  double weights_[RUINS + RECREATES];
+  double scores_[RUINS + RECREATES];
+  int uses_[RUINS + RECREATES];
+};
+
+Alns::Alns(const Solution & start, const std::string & accept)
+  : current_(start)
+  , best_(start)
+  , currentCost_(start.cost())
+  , bestCost_(currentCost_)
+  , acceptance_(makeAcceptance(accept))
+{
+  std::fill(weights_, weights_ + RUINS + RECREATES, 1.0);
+  std::fill(scores_, scores_ + RUINS + RECREATES, 0.0);
+  std::fill(uses_, uses_ + RUINS + RECREATES, 0);
+}
+
+int Alns::choose_(const double * weights, int n)
+{
+  double sum = 0;
+  for (int i = 0; i < n; ++i)
+    sum += weights[i];
+  double x = std::uniform_real_distribution<>(0, sum)(re);
+  for (int i = 0; i + 1 < n; ++i)
+  {
+    x -= weights[i];
+    if (x < 0)
+      return i;
+  }
+  return n - 1;
+}
+
+void Alns::adapt_()
+{
+  const double REACTION = 0.1;
+  for (int i = 0; i < RUINS + RECREATES; ++i)
+  {
+    if (uses_[i] > 0)
+      weights_[i] = (1 - REACTION) * weights_[i] + REACTION * scores_[i] / uses_[i];
+    weights_[i] = std::max(weights_[i], 0.05);
+    scores_[i] = 0;
+    uses_[i] = 0;
+  }
+}
+
+void Alns::run(std::chrono::steady_clock::time_point startTime, double timeLimit, long long iterations,
+  Incumbent & incumbent)
+{
+  // scores of the operators for a new best, an improving and an accepted solution
+  const double NEW_BEST = 33, IMPROVED = 9, ACCEPTED = 13;
+  int n = (int)customers.size() - D;
+  if (n == 0)
+    return; // only depots, nothing to ruin
+  int maxRemoved = std::max(1, std::min(40, n * 3 / 10));
+  std::uniform_int_distribution<> removedCount(1, maxRemoved);
+  std::vector<int> removed;
+  for (long long iter = 1; ; ++iter)
+  {
+    double progress = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count() / timeLimit;
+    if (iterations > 0)
+      progress = std::max(progress, (double)(iter - 1) / iterations);
+    if (progress >= 1)
+      break;
+    int ruin = choose_(weights_, RUINS);
+    int recreate = choose_(weights_ + RUINS, RECREATES);
+    Solution candidate = current_;
+    removed.clear();
+    int count = removedCount(re);
+    if (ruin == 0)
+      candidate.ruinRandom(count, removed);
+    else if (ruin == 1)
+      candidate.ruinWorst(count, removed);
+    else
+      candidate.ruinRelated(count, removed);
+    std::shuffle(removed.begin(), removed.end(), re);
+    double score = 0;
+    if (candidate.recreate(removed, recreate + 1))
+    {
+      candidate.optimizeRoutes();
+      double cost = candidate.cost();
+      acceptance_->start(progress, currentCost_);
+      if (cost < bestCost_ - 1e-9)
+      {
+        best_ = candidate;
+        bestCost_ = cost;
+        score = NEW_BEST;
+        std::lock_guard<std::mutex> lock(incumbent.mutex);
+        incumbent.offer(best_, bestCost_);
+      }
+      else if (cost < currentCost_ - 1e-9)
+        score = IMPROVED;
+      else if (acceptance_->accept(cost - currentCost_))
+        score = ACCEPTED;
+      if (score > 0)
+      {
+        current_ = std::move(candidate);
+        currentCost_ = cost;
+      }
+    }
+    scores_[ruin] += score;
+    scores_[RUINS + recreate] += score;
+    ++uses_[ruin];
+    ++uses_[RUINS + recreate];
+    if (iter % SEGMENT == 0)
+      adapt_();
+
+    if (iter % EXCHANGE == 0)
+    {
+      best_.localSearch();
+      bestCost_ = best_.cost();
+      std::lock_guard<std::mutex> lock(incumbent.mutex);
+      if (!incumbent.offer(best_, bestCost_) && incumbent.cost < bestCost_ - 1e-9)
+      {
+        best_ = current_ = incumbent.solution;
+        bestCost_ = currentCost_ = incumbent.cost;
+      }
+    }
+  }
+  best_.localSearch();
+  bestCost_ = best_.cost();
+  std::lock_guard<std::mutex> lock(incumbent.mutex);
+  incumbent.offer(best_, bestCost_);
+}
+
+// hybrid genetic search (Vidal): a population of locally optimal solutions; offspring are made by OX
+// crossover of the giant tours of two parents, cut into routes by Split and educated by the local
+// search, the individuals are ranked both by cost and by distance to the others to keep the
+// population diverse
+class Hgs
+{
+public:
+  // penalty - initial weight of the capacity excess in the education (0 - the capacity is never exceeded),
+  // it adapts to keep about FEASIBLE of the offspring within the capacity before the repair
+  Hgs(const Solution & start, double penalty);
+  // runs until the deadline or given number of offspring (0 - unlimited), the offspring of one
+  // generation, one per worker of the pool, are educated in parallel; the incumbent gets each new best
+  // solution
+  void run(std::chrono::steady_clock::time_point startTime, double timeLimit, long long iterations,
+    ThreadPool & pool, Incumbent & incumbent);
+private:
+  static const int MU = 12; // population after the survivors selection
+  static const int LAMBDA = 20; // offspring added before it
+  static const int ELITE = 4; // weight of the diversity in the fitness is 1 - ELITE / population
+  static const int CLOSE = 5; // the diversity is the average distance to that many closest individuals
+  static const int RESTART = 5000; // offspring without a new best before all but the best are replaced
+  static constexpr double FEASIBLE = 0.2; // target share of the offspring within the capacity
+  static const int ADAPT = 100; // offspring between the penalty updates
+
+  struct Individual
+  {
+    Solution solution;
+    double cost;
+    double fitness; // rank by cost and by diversity, lower is better
+  };
+
+  void add_(Solution && s);
+  void remove_(int i);
+  void updateFitness_();
+  // removes the worst by fitness, clones first, down to MU individuals
+  void selectSurvivors_();
+  // parent chosen by binary tournament on the fitness
+  const Solution & select_() const;
+  // copies a random cyclic segment of the first tour, the rest of the customers follow in the order
+  // of the second one from the end of the segment
+  static std::vector<int> crossover_(const std::vector<int> & a, const std::vector<int> & b);
+  // relocations, route TSP pass and local search until none of them helps
+  static void educate_(Solution & s);
+
+  std::vector<Individual> population_;
+  std::vector<std::vector<double>> distance_; // broken pairs between the individuals
+  double penalty_ = 0;
+  double minPenalty_ = 0;
+  double maxPenalty_ = 0;
+};
+
+Hgs::Hgs(const Solution & start, double penalty)
+  : penalty_(penalty)
+  , minPenalty_(penalty / 100)
+  , maxPenalty_(penalty * 100)
+{
+  add_(Solution(start));
+}
+
+void Hgs::add_(Solution && s)
+{
+  std::vector<double> row;
+  for (int i = 0; i < (int)population_.size(); ++i)
+  {
+    double d = s.brokenPairs(population_[i].solution);
+    distance_[i].push_back(d);
+    row.push_back(d);
+  }
+  row.push_back(0);
+  distance_.push_back(std::move(row));
+  double cost = s.cost();
+  population_.push_back(Individual{ std::move(s), cost, 0 });
+}
+
+void Hgs::remove_(int i)
+{
+  population_.erase(population_.begin() + i);
+  distance_.erase(distance_.begin() + i);
+  for (auto & row : distance_)
+    row.erase(row.begin() + i);
+}
+
+void Hgs::updateFitness_()
+{
+  int p = (int)population_.size();
+  if (p == 1)
+  {
+    population_[0].fitness = 0;
+    return;
+  }
+  std::vector<std::pair<double, int>> byCost, byDiversity;
+  std::vector<double> d;
+  for (int i = 0; i < p; ++i)
+  {
+    d = distance_[i];
+    d.erase(d.begin() + i);
+    int close = (int)d.size() < CLOSE ? (int)d.size() : CLOSE;
+    std::partial_sort(d.begin(), d.begin() + close, d.end());
+    double diversity = 0;
+    for (int k = 0; k < close; ++k)
+      diversity += d[k];
+    byCost.emplace_back(population_[i].cost, i);
+    byDiversity.emplace_back(-diversity / close, i);
+  }
+  std::sort(byCost.begin(), byCost.end());
+  std::sort(byDiversity.begin(), byDiversity.end());
+  double weight = 1 - (double)ELITE / p;
+  for (int r = 0; r < p; ++r)
+  {
+    population_[byCost[r].second].fitness = (double)r / (p - 1);
+    population_[byDiversity[r].second].fitness += weight * r / (p - 1);
+  }
+}
+
+void Hgs::selectSurvivors_()
+{
+  while ((int)population_.size() > MU)
+  {
+    updateFitness_();
+    int worst = -1;
+    bool worstClone = false;
+    for (int i = 0; i < (int)population_.size(); ++i)
+    {
+      bool clone = false;
+      for (int k = 0; k < (int)population_.size(); ++k)
+        clone = clone || (k != i && distance_[i][k] < 1e-9);
+      if (worst < 0 || clone > worstClone || (clone == worstClone && population_[i].fitness > population_[worst].fitness))
+      {
+        worst = i;
+        worstClone = clone;
+      }
+    }
+    remove_(worst);
+  }
+}
+
+const Solution & Hgs::select_() const
+{
+  std::uniform_int_distribution<> pick(0, (int)population_.size() - 1);
+  const Individual & a = population_[pick(re)];
+  const Individual & b = population_[pick(re)];
+  return a.fitness <= b.fitness ? a.solution : b.solution;
+}
+
+std::vector<int> Hgs::crossover_(const std::vector<int> & a, const std::vector<int> & b)
+{
+  int m = (int)a.size();
+  if (m < 2)
+    return a;
+  std::uniform_int_distribution<> pos(0, m - 1);
+  int from = pos(re), to = pos(re);
+  std::vector<int> child(m);
+  std::vector<char> taken(customers.size(), 0);
+  for (int k = from; ; k = (k + 1) % m)
+  {
+    child[k] = a[k];
+    taken[a[k]] = 1;
+    if (k == to)
+      break;
+  }
+  int k = (to + 1) % m;
+  for (int q = 1; q <= m; ++q)
+  {
+    int c = b[(to + q) % m];
+    if (!taken[c])
+    {
+      child[k] = c;
+      k = (k + 1) % m;
+    }
+  }
+  return child;
+}
+
+void Hgs::educate_(Solution & s)
+{
+  for (double before = DBL_MAX; s.cost() < before - 1e-9; )
+  {
+    before = s.cost();
+    s.relocateCustomers();
+    s.optimizeRoutes();
+    s.localSearch();
+  }
+}
+
+void Hgs::run(std::chrono::steady_clock::time_point startTime, double timeLimit, long long iterations,
+  ThreadPool & pool, Incumbent & incumbent)
+{
+  int threads = pool.size();
+  std::vector<int> all;
+  for (int c = D; c < (int)customers.size(); ++c)
+    all.push_back(c);
+  double bestCost = population_[0].cost;
+  long long made = 0, lastBest = 0;
+  int random = MU; // offspring still to be made from random tours
+  std::vector<std::vector<int>> tours(threads);
+  std::vector<unsigned> seeds(threads);
+  std::vector<std::default_random_engine> engines(threads);
+  std::vector<Solution> offspring(threads, population_[0].solution);
+  std::vector<char> withinCapacity(threads);
+  int sampled = 0, feasible = 0;
+  for (;;)
+  {
+    double progress = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count() / timeLimit;
+    if (iterations > 0)
+      progress = std::max(progress, (double)made / iterations);
+    if (progress >= 1)
+      break;
+
+    // parents are chosen and crossed here, the offspring are built and educated by the threads
+    updateFitness_();
+    for (int t = 0; t < threads; ++t)
+    {
+      if (random > 0)
+      {
+        // sweep from a random angle
+        --random;
+        const double PI = acos(-1.0);
+        double start = std::uniform_real_distribution<>(-PI, PI)(re);
+        auto angle = [&](int c)
+        {
+          double a = atan2(customers[c].y - customers[0].y, customers[c].x - customers[0].x) - start;
+          return a < 0 ? a + 2 * PI : a;
+        };
+        tours[t] = all;
+        std::sort(tours[t].begin(), tours[t].end(), [&](int x, int y) { return angle(x) < angle(y); });
+      }
+      else
+        tours[t] = crossover_(select_().giantTour(), select_().giantTour());
+      seeds[t] = re();
+    }
+    // the first offspring continues the engine of this thread, the others are seeded
+    engines[0] = re;
+    for (int t = 1; t < threads; ++t)
+      engines[t].seed(seeds[t]);
+    pool.parallelFor(threads, [&](int t, int)
+    {
+      re = engines[t];
+      offspring[t] = Solution(tours[t]);
+      offspring[t].setPenalty(penalty_);
+      educate_(offspring[t]);
+      withinCapacity[t] = offspring[t].excess() == 0;
+      if (!withinCapacity[t] && penalty_ > 0 && offspring[t].repair())
+        educate_(offspring[t]);
+      engines[t] = re;
+    });
+    re = engines[0];
+    made += threads;
+
+    if (penalty_ > 0)
+    {
+      for (int t = 0; t < threads; ++t)
+        feasible += withinCapacity[t];
+      sampled += threads;
+      if (sampled >= ADAPT)
+      {
+        double share = (double)feasible / sampled;
+        if (share < FEASIBLE - 0.05)
+          penalty_ = std::min(maxPenalty_, penalty_ * 1.2);
+        else if (share > FEASIBLE + 0.05)
+          penalty_ = std::max(minPenalty_, penalty_ * 0.85);
+        sampled = feasible = 0;
+      }
+    }
+
+    // infeasible offspring (forced insertions or failed repairs) are dropped
+    for (int t = 0; t < threads; ++t)
+    {
+      if (!offspring[t].feasible())
+        continue;
+      double cost = offspring[t].cost();
+      if (cost < bestCost - 1e-9)
+      {
+        bestCost = cost;
+        lastBest = made;
+        std::lock_guard<std::mutex> lock(incumbent.mutex);
+        incumbent.offer(offspring[t], cost);
+      }
+      add_(std::move(offspring[t]));
+    }
+    if ((int)population_.size() >= MU + LAMBDA)
+      selectSurvivors_();
+
+    if (made - lastBest >= RESTART)
+    {
+      int best = 0;
+      for (int i = 1; i < (int)population_.size(); ++i)
+      {
+        if (population_[i].cost < population_[best].cost)
+          best = i;
+      }
+      Solution keep = population_[best].solution;
+      population_.clear();
+      distance_.clear();
+      add_(std::move(keep));
+      random = MU;
+      lastBest = made;
+    }
+  }
+}
+
+struct Options
+{
+  const char * input = nullptr;
+  std::string mode = "moves"; // moves - customer moves and swaps, alns - parallel ALNS, hgs - hybrid genetic search
+  std::string accept = "sa"; // acceptance of moves: greedy, sa, rrt or lahc
+  double timeLimit = 10; // seconds
+  long long iterations = 0; // batches of moves, ALNS iterations of each thread or HGS offspring, 0 - unlimited
+  const char * stream = nullptr; // file, named pipe or "-" for stdout to write each improved solution to
+  int threads = std::max(1, (int)std::thread::hardware_concurrency()); // in alns and hgs modes
+  bool penalty = false; // in moves and hgs modes the capacity may be exceeded at an adaptive cost
+};
+
+bool parseOptions(int argc, char * argv[], Options & o)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string a = argv[i];
+    if (a == "--mode" && i + 1 < argc)
+      o.mode = argv[++i];
+    else if (a == "--accept" && i + 1 < argc)
+      o.accept = argv[++i];
+    else if (a == "--threads" && i + 1 < argc)
+      o.threads = std::max(1, atoi(argv[++i]));
+    else if (a == "--time-limit" && i + 1 < argc)
+      o.timeLimit = atof(argv[++i]);
+    else if (a == "--iterations" && i + 1 < argc)
+      o.iterations = atoll(argv[++i]);
+    else if (a == "--stream" && i + 1 < argc)
+      o.stream = argv[++i];
+    else if (a == "--penalty")
+      o.penalty = true;
+    else if (a.compare(0, 2, "--") != 0 && !o.input)
+      o.input = argv[i];
+    else
+      return false;
+  }
+  return o.input != nullptr && o.timeLimit > 0 && (o.mode == "moves" || o.mode == "alns" || o.mode == "hgs");
+}
+
+int main(int argc, char * argv[])
+{
+  auto startTime = std::chrono::steady_clock::now();
+  auto elapsed = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count(); };
+
+  Options opts;
+  if (!parseOptions(argc, argv, opts))
+    return 1;
+  std::unique_ptr<Acceptance> acceptance = makeAcceptance(opts.accept);
+  if (!acceptance)
+    return 1;
+  readData(opts.input);
+  prepareDistances(10);
+  prepareKeys();
+
+  // the workers are shared by the constructions, the route optimization and the HGS generations
+  ThreadPool pool(opts.threads);
+  Solution current(&pool);
+  current.optimizeRoutes(&pool);
+  current.localSearch();
+  Solution best = current;
+  double bestCost = best.cost();
+
+  std::ofstream log("vrp.log", std::ofstream::app);
+  log.precision(12);
+  // one line per improvement: "solution <seconds> <cost> | 0 ... 0 | 0 ... 0", the last complete line
+  // is the best solution so far; opening a named pipe waits for its reader
+  std::ofstream streamFile;
+  std::ostream * stream = nullptr;
+  if (opts.stream)
+  {
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN); // the reader may go away, the search continues
+#endif
+    if (std::string(opts.stream) == "-")
+      stream = &std::cout;
+    else
+    {
+      streamFile.open(opts.stream);
+      stream = &streamFile;
+    }
+    stream->precision(12);
+  }
+  auto streamBest = [&](const Solution & s, double cost)
+  {
+    if (!stream)
+      return;
+    *stream << "solution " << elapsed() << ' ' << cost;
+    s.printRoutes(*stream);
+    *stream << std::endl;
+  };
+  streamBest(best, bestCost);
+
+  if (opts.mode == "alns")
+  {
+    Incumbent incumbent(current);
+    incumbent.improved = streamBest;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < opts.threads; ++t)
+    {
+      threads.emplace_back([&, t]()
+      {
+        re.seed(t + 1);
+        Alns alns(current, opts.accept);
+        alns.run(startTime, opts.timeLimit, opts.iterations, incumbent);
+      });
+    }
+    for (auto & t : threads)
+      t.join();
+    best = incumbent.solution;
+    bestCost = incumbent.cost;
+    log << "N=" << customers.size()
+      << "\tthreads=" << opts.threads
+      << "\tbest=" << bestCost
+      << '\n';
+  }
+  if (opts.mode == "hgs")
+  {
+    Incumbent incumbent(current);
+    incumbent.improved = streamBest;
+    Hgs hgs(current, opts.penalty ? initialPenalty() : 0);
+    hgs.run(startTime, opts.timeLimit, opts.iterations, pool, incumbent);
+    best = incumbent.solution;
+    bestCost = incumbent.cost;
+    log << "N=" << customers.size()
+      << "\tthreads=" << opts.threads
+      << "\tbest=" << bestCost
+      << '\n';
+  }
+  // the moves are taken by the acceptance policy, the local search descends after each batch
+  double startPenalty = initialPenalty();
+  if (opts.penalty && opts.mode == "moves")
+    current.setPenalty(startPenalty);
+  for (long long iter = 0; opts.mode == "moves"; ++iter)
+  {
+    double progress = elapsed() / opts.timeLimit;
+    if (opts.iterations > 0)
+      progress = std::max(progress, (double)iter / opts.iterations);
+    if (progress >= 1)
+      break;
+    acceptance->start(progress, current.cost() + current.penalty() * current.excess());
+    current.moveCustomers(1000, *acceptance);
+    current.swapCustomers(1000, *acceptance);
+    current.optimizeRoutes(&pool);
+    current.localSearch();
+    double cost = current.cost();
+    if (cost < bestCost && current.penalty() > 0 && current.excess() > 0)
+    {
+      // over the capacity, the repair only lengthens the routes
+      Solution repaired = current;
+      if (repaired.repair())
+      {
+        repaired.localSearch();
+        if (repaired.cost() < bestCost)
+        {
+          best = repaired;
+          bestCost = best.cost();
+          streamBest(best, bestCost);
+        }
+      }
+    }
+    else if (cost < bestCost)
+    {
+      best = current;
+      bestCost = cost;
+      streamBest(best, bestCost);
+    }
+    // the weight grows while the routes are over the capacity and falls while they are not
+    if (opts.penalty)
+    {
+      double weight = current.penalty() * (current.excess() > 0 ? 1.2 : 1 / 1.2);
+      current.setPenalty(std::min(100 * startPenalty, std::max(startPenalty / 100, weight)));
+    }
+    if (iter % 100 == 0)
+    {
+      log << "N=" << customers.size()
+        << "\titer=" << iter
+        << "\tcurrent=" << cost
+        << "\tbest=" << bestCost
+        << '\n';
+    }
+  }
+  log << "N=" << customers.size()
+    << "\tmove cache lookups=" << MoveCache::lookups
+    << "\thits=" << MoveCache::hits
+    << "\thit rate=" << (double)MoveCache::hits / std::max(1LL, MoveCache::lookups.load())
+    << '\n';
+  log.flush();
+
+  // the construction puts the customers it cannot fit in over the capacity or time windows, and the
+  // best solution is that one until a search finds better; the repair may still find room for them
+  if (!best.feasible())
+  {
+    Solution repaired = best;
+    repaired.setPenalty(startPenalty);
+    repaired.repair();
+    repaired.localSearch();
+    if (repaired.feasible())
+    {
+      best = repaired;
+      bestCost = best.cost();
+    }
+  }
+  if (!best.feasible())
+  {
+    std::cerr << "no solution within the capacity and time windows found" << std::endl;
+    return 1;
   }
 
   std::ostringstream os;